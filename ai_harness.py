@@ -1,5 +1,7 @@
 from google import genai
 import ctypes
+import json
+import logging
 import os
 
 
@@ -58,6 +60,15 @@ lib.verify_proof.argtypes = [ctypes.c_char_p, ctypes.POINTER(ctypes.c_char_p)]
 lib.verify_proof.restype = ctypes.c_int
 lib.free_output.argtypes = [ctypes.c_char_p]
 lib.free_output.restype = None
+lib.verify_proof_goal.argtypes = [ctypes.c_char_p, ctypes.POINTER(ctypes.c_char_p), ctypes.c_int,
+                                  ctypes.c_char_p, ctypes.POINTER(ctypes.c_char_p)]
+lib.verify_proof_goal.restype = ctypes.c_int
+lib.pc_prove.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_int, ctypes.c_char_p,
+                         ctypes.c_void_p, ctypes.POINTER(ctypes.c_char_p)]
+lib.pc_prove.restype = ctypes.c_int
+lib.pc_prove_portfolio.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_int, ctypes.c_char_p,
+                                   ctypes.c_int, ctypes.c_void_p, ctypes.POINTER(ctypes.c_char_p)]
+lib.pc_prove_portfolio.restype = ctypes.c_int
 
 def verify_proof(proof_str: str):
     out_ptr = ctypes.c_char_p()
@@ -67,13 +78,165 @@ def verify_proof(proof_str: str):
         lib.free_output(out_ptr)
     return rc, output
 
+def _c_strings(strings):
+    return (ctypes.c_char_p * max(1, len(strings)))(*[s.encode('utf-8') for s in strings])
+
+def verify_proof_goal(proof_str: str, premises, goal):
+    """Like verify_proof, but Premise lines must be among `premises` and the
+    last line must be `goal`."""
+    out_ptr = ctypes.c_char_p()
+    rc = lib.verify_proof_goal(proof_str.encode('utf-8'), _c_strings(premises), len(premises),
+                               goal.encode('utf-8'), ctypes.byref(out_ptr))
+    output = out_ptr.value.decode('utf-8') if out_ptr.value else ''
+    if out_ptr:
+        lib.free_output(out_ptr)
+    return rc, output
+
+def search_proof(premises, goal):
+    """Return a proof found by the checker's own search portfolio, or None."""
+    out_ptr = ctypes.c_char_p()
+    rc = lib.pc_prove_portfolio(_c_strings(premises), len(premises), goal.encode('utf-8'), 0, None, ctypes.byref(out_ptr))
+    proof = out_ptr.value.decode('utf-8') if out_ptr.value else None
+    if out_ptr:
+        lib.free_output(out_ptr)
+    return proof if rc == 0 else None
+
+
+# --- Goal-to-proof cache ---
+# Proofs are stored under an alpha-normalized (premises, goal) key: atoms are
+# renamed A, B, C, ... in order of first appearance, so a goal that only
+# differs from a solved one by the choice of letters hits the same entry.
+# The order of the premises does not matter either: atoms are numbered from
+# the goal first, then through the premises in a canonical order, and the
+# renamed premises are sorted in the key.
+CACHE_PATH = os.path.join(os.path.dirname(__file__), "proof_cache.json")
+ATOMS = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+
+def _rename(formula, mapping):
+    return "".join(mapping.get(ch, ch) for ch in formula)
+
+def _rename_just(just, mapping):
+    # Only Substitution justifications mention atoms ("Substitution P=cQR");
+    # Premise/AX1/MP etc. must be left untouched.
+    if just[:12].lower() == "substitution":
+        return just[:12] + _rename(just[12:], mapping)
+    return just
+
+def _proof_lines(proof):
+    lines = []
+    for raw in proof.splitlines():
+        raw = raw.strip()
+        if not raw or raw.startswith("#"):
+            continue
+        parts = raw.split(None, 2)
+        if len(parts) < 3:
+            return None
+        lines.append(parts)
+    return lines
+
+def _rename_proof(lines, mapping):
+    return "".join("%s %s %s\n" % (n, _rename(f, mapping), _rename_just(j, mapping))
+                   for n, f, j in lines)
+
+def _atoms_of(texts):
+    seen = []
+    for t in texts:
+        for ch in t:
+            if ch in ATOMS and ch not in seen:
+                seen.append(ch)
+    return seen
+
+def alpha_normalize(premises, goal):
+    """Return (key, mapping) where mapping renames the caller's atoms to canonical ones."""
+    mapping = {a: ATOMS[i] for i, a in enumerate(_atoms_of([goal]))}
+    # Take the premises one at a time, each time the one that reads first
+    # with the atoms named so far (unnamed ones as "~"), and name its new
+    # atoms. Premises that still read alike may leave the key depending on
+    # their order, which costs a cache miss, never a wrong hit.
+    rest = list(premises)
+    while rest:
+        shape = lambda p: "".join(mapping.get(ch, "~" if ch in ATOMS else ch) for ch in p)
+        first = min(rest, key=shape)
+        rest.remove(first)
+        for a in _atoms_of([first]):
+            if a not in mapping:
+                mapping[a] = ATOMS[len(mapping)]
+    key = ",".join(sorted(_rename(p, mapping) for p in premises)) + "|" + _rename(goal, mapping)
+    return key, mapping
+
+class ProofCache:
+    def __init__(self, path=CACHE_PATH):
+        self.path = path
+        self.entries = {}
+        if os.path.exists(path):
+            try:
+                with open(path) as f:
+                    entries = json.load(f)
+                if not isinstance(entries, dict):
+                    raise ValueError("not a JSON object")
+                self.entries = entries
+            except (OSError, ValueError) as e:
+                # a damaged cache only costs the proofs it held
+                logging.getLogger(__name__).warning("ignoring proof cache %s: %s", path, e)
+
+    def lookup(self, premises, goal):
+        key, mapping = alpha_normalize(premises, goal)
+        stored = self.entries.get(key)
+        if stored is None:
+            return None
+        lines = _proof_lines(stored)
+        # Invert the mapping; canonical atoms that only occur inside the proof
+        # (e.g. the Q of an AX1 instance) get letters the caller isn't using.
+        inverse = {c: a for a, c in mapping.items()}
+        spare = [a for a in ATOMS if a not in mapping]
+        for c in _atoms_of(f + j[12:] for _, f, j in lines):
+            if c not in inverse:
+                inverse[c] = spare.pop(0)
+        return _rename_proof(lines, inverse)
+
+    def store(self, premises, goal, proof):
+        key, mapping = alpha_normalize(premises, goal)
+        lines = _proof_lines(proof)
+        if lines is None:
+            return
+        extra = [a for a in _atoms_of(f + j[12:] for _, f, j in lines) if a not in mapping]
+        if len(mapping) + len(extra) > len(ATOMS):
+            return
+        for a in extra:
+            mapping[a] = ATOMS[len(mapping)]
+        self.entries[key] = _rename_proof(lines, mapping)
+        tmp = self.path + ".tmp"
+        with open(tmp, "w") as f:
+            json.dump(self.entries, f, indent=1, sort_keys=True)
+        os.replace(tmp, self.path)
+
+def solve(premises, goal, cache=None):
+    """Return (proof, rc, output), consulting the cache before calling the model.
+    If the model's proof does not check, the checker's proof search gets a try.
+    Every proof, cached ones included, must prove `goal` from `premises`."""
+    cache = cache if cache is not None else ProofCache()
+    proof = cache.lookup(premises, goal)
+    if proof is not None:
+        rc, out = verify_proof_goal(proof, premises, goal)
+        if rc == 0:
+            return proof, rc, out
+    proof = proof_generator(premises, goal)
+    rc, out = verify_proof_goal(proof, premises, goal)
+    if rc != 0:
+        found = search_proof(premises, goal)
+        if found is not None:
+            proof = found
+            rc, out = verify_proof_goal(proof, premises, goal)
+    if rc == 0:
+        cache.store(premises, goal, proof)
+    return proof, rc, out
+
 if __name__ == "__main__":
-  # Example usage: generate and verify proof
+  # Example usage: generate (or fetch from cache) and verify proof
   premises = ["cPZ","ccPZZ","cZQ", "P"]
   goal = "ccPZcccPQZZ"
-  proof = proof_generator(premises, goal)
+  proof, rc, out = solve(premises, goal)
   print("Generated Proof:\n", proof)
-  rc, out = verify_proof(proof)
   print("\nVerifier Return code:", rc)
   print("Verifier Output:")
   print(out)
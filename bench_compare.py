@@ -0,0 +1,284 @@
+# bench_compare.py
+# Stores benchmark results as a baseline and compares later runs against it.
+#
+#   python3 bench_compare.py save kernels.jsonl results.jsonl summary.json -o baseline.json
+#   python3 bench_compare.py compare baseline.json kernels.jsonl results.jsonl summary.json
+#
+# Accepted inputs (JSON lines, detected per line):
+#   - bench_kernels output: {"name", "mean_ns", "stddev_ns", "reps", ...};
+#     each line is one benchmark, in ns per call.
+#   - proof_checker --batch / --dir / shard_runner output: {"id", "rc", "us", ...};
+#     the per-proof verify times of all such files form one benchmark, in us
+#     per proof. It is named "corpus", or --corpus-name NAME, whatever the
+#     files are called, so a baseline saved from corpus.jsonl compares
+#     against new_corpus.jsonl. A proof that occurs more than once (repeated
+#     runs) counts with its mean time.
+#   - the shard_runner summary (its stderr, one JSON object): records_per_s
+#     of all summaries forms the benchmark "throughput", in records per s.
+#
+# A benchmark regresses when it got slower by more than its threshold AND a
+# two-sided t-test rejects "no change" at the chosen alpha, so noisy
+# benchmarks do not trip the gate on run-to-run jitter. The corpus is
+# compared proof by proof: the change is the geometric mean of the per-proof
+# time ratios, tested with a paired t-test on their logs, so the spread
+# between small and large proofs does not hide a slowdown of all of them.
+# Kernels and throughput use Welch's t-test on their summaries. Benchmarks
+# with at least P99_MIN_SAMPLES samples (the corpus) also get a "<name> p99"
+# latency check, which has no test: p99 slowing by more than its threshold
+# (default DEFAULT_P99_THRESHOLD) regresses. Thresholds can be set per
+# benchmark with fnmatch patterns in a JSON config:
+#   {"alpha": 0.01, "default": 0.05, "p99": 0.10,
+#    "thresholds": {"match_pattern/*": 0.10, "corpus": 0.03, "corpus p99": 0.2}}
+# (the first matching pattern wins; "default" and "p99" cover the rest).
+# compare exits with status 1 when anything regressed, or when a benchmark
+# of the baseline is missing from the current results.
+import argparse
+import fnmatch
+import json
+import math
+import sys
+
+DEFAULT_THRESHOLD = 0.05
+DEFAULT_P99_THRESHOLD = 0.10
+DEFAULT_ALPHA = 0.01
+P99_MIN_SAMPLES = 100
+
+
+def _summary(samples):
+    n = len(samples)
+    mean = sum(samples) / n
+    var = sum((x - mean) ** 2 for x in samples) / (n - 1) if n > 1 else 0.0
+    ordered = sorted(samples)
+    return {"mean": mean, "stddev": math.sqrt(var), "n": n,
+            "p50": ordered[n // 2], "p99": ordered[min(n - 1, int(math.ceil(0.99 * n)) - 1)]}
+
+
+def _read_records(path):
+    """The JSON records of a file: one object, or one per line."""
+    with open(path) as f:
+        text = f.read()
+    try:
+        rec = json.loads(text)
+        if isinstance(rec, dict):
+            return [rec]
+    except ValueError:
+        pass
+    return [json.loads(line) for line in text.splitlines() if line.strip()]
+
+
+def load_results(paths, corpus_name="corpus"):
+    """Read result files into {name: {"unit", "mean", "stddev", "n", ...}}."""
+    benches = {}
+    corpus = {}
+    throughput = []
+    for path in paths:
+        for rec in _read_records(path):
+            if "mean_ns" in rec:
+                benches[rec["name"]] = {"unit": "ns", "mean": rec["mean_ns"],
+                                        "stddev": rec["stddev_ns"], "n": rec["reps"],
+                                        "p50": rec.get("median_ns"), "p99": rec.get("p99_ns")}
+            elif "records_per_s" in rec:
+                if rec["records_per_s"]:
+                    throughput.append(float(rec["records_per_s"]))
+            elif "us" in rec and rec.get("rc") != -302:
+                corpus.setdefault(json.dumps(rec.get("id"), sort_keys=True), []).append(float(rec["us"]))
+    if corpus:
+        per_id = {k: sum(v) / len(v) for k, v in corpus.items()}
+        bench = _summary([x for v in corpus.values() for x in v])
+        bench["unit"] = "us"
+        bench["ids"] = per_id
+        benches[corpus_name] = bench
+    if throughput:
+        bench = _summary(throughput)
+        bench["unit"] = "rec/s"
+        bench["higher_is_better"] = True
+        benches["throughput"] = bench
+    return benches
+
+
+# ---------------- Welch's t-test ----------------
+
+def _betacf(a, b, x):
+    """Continued fraction for the regularized incomplete beta (Lentz)."""
+    tiny = 1e-300
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c, d = 1.0, 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    h = d
+    for m in range(1, 300):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        delta = d * c
+        h *= delta
+        if abs(delta - 1.0) < 1e-12:
+            break
+    return h
+
+
+def _betai(a, b, x):
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    lbeta = math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b)
+    front = math.exp(lbeta + a * math.log(x) + b * math.log(1.0 - x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return front * _betacf(a, b, x) / a
+    return 1.0 - front * _betacf(b, a, 1.0 - x) / b
+
+
+def welch_p(base, new):
+    """Two-sided p-value for equal means, from summary statistics."""
+    if base["n"] < 2 or new["n"] < 2:
+        return None
+    vb = base["stddev"] ** 2 / base["n"]
+    vn = new["stddev"] ** 2 / new["n"]
+    if vb + vn == 0.0:
+        return 0.0 if base["mean"] != new["mean"] else 1.0
+    t = (new["mean"] - base["mean"]) / math.sqrt(vb + vn)
+    df = (vb + vn) ** 2 / (vb ** 2 / (base["n"] - 1) + vn ** 2 / (new["n"] - 1))
+    return _betai(df / 2.0, 0.5, df / (df + t * t))
+
+
+def paired_change(base_ids, new_ids):
+    """(relative change, two-sided p) of the times of the proofs in both runs:
+    the geometric mean of the per-proof ratios, and a paired t-test on their
+    logs. None if fewer than two proofs are in both."""
+    logs = [math.log(new_ids[k] / base_ids[k]) for k in base_ids
+            if k in new_ids and base_ids[k] > 0 and new_ids[k] > 0]
+    n = len(logs)
+    if n < 2:
+        return None
+    mean = sum(logs) / n
+    sd = math.sqrt(sum((x - mean) ** 2 for x in logs) / (n - 1))
+    if sd == 0.0:
+        p = 0.0 if mean != 0.0 else 1.0
+    else:
+        t = mean / (sd / math.sqrt(n))
+        p = _betai((n - 1) / 2.0, 0.5, (n - 1) / (n - 1 + t * t))
+    return math.exp(mean) - 1.0, p
+
+
+# ---------------- Comparison ----------------
+
+def threshold_for(name, config, default_key="default", default=DEFAULT_THRESHOLD):
+    for pattern, value in config.get("thresholds", {}).items():
+        if fnmatch.fnmatchcase(name, pattern):
+            return value
+    return config.get(default_key, default)
+
+
+def _status(slowdown, limit, significant):
+    if slowdown > limit and significant:
+        return "REGRESSION"
+    if slowdown < -limit and significant:
+        return "improved"
+    return "ok"
+
+
+def compare(baseline, current, config):
+    alpha = config.get("alpha", DEFAULT_ALPHA)
+    rows = []
+    for name in sorted(set(baseline) | set(current)):
+        base, new = baseline.get(name), current.get(name)
+        if base is None or new is None:
+            rows.append({"name": name, "status": "new" if base is None else "MISSING"})
+            continue
+        paired = paired_change(base["ids"], new["ids"]) if "ids" in base and "ids" in new else None
+        if paired is not None:
+            change, p = paired
+        else:
+            change = (new["mean"] - base["mean"]) / base["mean"] if base["mean"] else 0.0
+            p = welch_p(base, new)
+        # for throughput a drop is the slowdown
+        slowdown = -change if base.get("higher_is_better") else change
+        limit = threshold_for(name, config)
+        rows.append({"name": name, "status": _status(slowdown, limit, p is None or p < alpha),
+                     "unit": new.get("unit"), "base": base["mean"], "new": new["mean"],
+                     "change": change, "p": p, "threshold": limit})
+        if (base.get("p99") and new.get("p99") is not None
+                and min(base["n"], new["n"]) >= P99_MIN_SAMPLES):
+            pname = name + " p99"
+            change = (new["p99"] - base["p99"]) / base["p99"]
+            limit = threshold_for(pname, config, "p99", DEFAULT_P99_THRESHOLD)
+            rows.append({"name": pname, "status": _status(change, limit, True),
+                         "unit": new.get("unit"), "base": base["p99"], "new": new["p99"],
+                         "change": change, "p": None, "threshold": limit})
+    return rows
+
+
+def print_rows(rows, out):
+    out.write("%-44s %14s %14s %8s %9s  %s\n" % ("benchmark", "baseline", "current", "change", "p", "status"))
+    for r in rows:
+        if "change" not in r:
+            out.write("%-44s %14s %14s %8s %9s  %s\n" % (r["name"], "-", "-", "-", "-", r["status"]))
+            continue
+        p = "-" if r["p"] is None else "%.2g" % r["p"]
+        out.write("%-44s %12.1f%-2s %12.1f%-2s %+7.1f%% %9s  %s\n" % (
+            r["name"], r["base"], r["unit"], r["new"], r["unit"], 100 * r["change"], p, r["status"]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Save and compare proof checker benchmark baselines.")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    sp = sub.add_parser("save", help="store result files as a baseline")
+    sp.add_argument("results", nargs="+")
+    sp.add_argument("-o", "--output", required=True)
+    sp.add_argument("--corpus-name", default="corpus", help="name of the corpus benchmark (default: corpus)")
+    cp = sub.add_parser("compare", help="compare result files against a baseline")
+    cp.add_argument("baseline")
+    cp.add_argument("results", nargs="+")
+    cp.add_argument("--config", help="JSON file with alpha, default and per-pattern thresholds")
+    cp.add_argument("--threshold", type=float, help="default relative slowdown allowed (e.g. 0.05)")
+    cp.add_argument("--p99-threshold", type=float, help="default relative p99 slowdown allowed (e.g. 0.10)")
+    cp.add_argument("--alpha", type=float, help="significance level of the t-test")
+    cp.add_argument("--json", action="store_true", help="print the comparison as JSON")
+    cp.add_argument("--corpus-name", default="corpus", help="name of the corpus benchmark (default: corpus)")
+    args = ap.parse_args()
+
+    if args.cmd == "save":
+        benches = load_results(args.results, args.corpus_name)
+        with open(args.output, "w") as f:
+            json.dump({"benchmarks": benches}, f, indent=1, sort_keys=True)
+        print("saved %d benchmarks to %s" % (len(benches), args.output))
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)["benchmarks"]
+    config = {}
+    if args.config:
+        with open(args.config) as f:
+            config = json.load(f)
+    if args.threshold is not None:
+        config["default"] = args.threshold
+    if args.p99_threshold is not None:
+        config["p99"] = args.p99_threshold
+    if args.alpha is not None:
+        config["alpha"] = args.alpha
+    rows = compare(baseline, load_results(args.results, args.corpus_name), config)
+    if args.json:
+        json.dump(rows, sys.stdout, indent=1)
+        sys.stdout.write("\n")
+    else:
+        print_rows(rows, sys.stdout)
+    regressions = [r["name"] for r in rows if r["status"] == "REGRESSION"]
+    missing = [r["name"] for r in rows if r["status"] == "MISSING"]
+    if regressions:
+        sys.stderr.write("%d regression(s): %s\n" % (len(regressions), ", ".join(regressions)))
+    if missing:
+        sys.stderr.write("%d benchmark(s) missing from the results: %s\n" % (len(missing), ", ".join(missing)))
+    return 1 if regressions or missing else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
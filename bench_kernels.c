@@ -0,0 +1,354 @@
+// bench_kernels.c
+// Microbenchmarks for the checker's inner kernels: parse_node, is_wff_str,
+// equal_tree, match_pattern_rec (against each axiom), subst_equal (the
+// Substitution check) and check_modus_ponens, on formulas from a single atom up to millions of nodes.
+//
+// Build (the kernels are static, so the checker source is included directly):
+//  gcc -std=c11 -O2 -Wall -pthread -o bench_kernels bench_kernels.c -lm
+//
+// Run:
+//  ./bench_kernels [--reps R] [--max-nodes N] [--min-ms T] [--filter SUBSTR]
+//
+// Each case is one JSON line on stdout:
+//   {"name":"equal_tree/balanced/65535","kernel":"equal_tree","shape":"balanced",
+//    "nodes":65535,"depth":16,"iters":..,"reps":..,"mean_ns":..,"stddev_ns":..,
+//    "min_ns":..,"median_ns":..,"p99_ns":..,"max_ns":..}
+// Times are per kernel call. A case runs `iters` calls per repetition (enough
+// to fill --min-ms) and the statistics are over the per-call time of each
+// repetition. Setup, and freeing what the kernel allocated, is not timed.
+//
+// Shapes: "balanced" is a complete implication tree (depth log2 n); "comb" is
+// a right-nested chain cAcBcC... (depth n/2), the worst case for the
+// recursive kernels. Everything runs on a thread with a large stack so the
+// deep combs do not overflow it.
+
+#include "proof_checker.c"
+
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef struct {
+    int reps;
+    size_t max_nodes;
+    double min_ns;
+    const char *filter;
+} BenchOpts;
+
+static BenchOpts g_opts = { 15, (size_t)1 << 21, 2e6, NULL };
+static volatile uintptr_t g_sink;
+
+static double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* ---------------- Formula generators ---------------- */
+
+static Node *mk_node(char kind, char atom, Node *l, Node *r) {
+    Node *n = (Node*)malloc(sizeof(Node));
+    if (!n) { perror("malloc"); exit(EXIT_FAILURE); }
+    n->kind = kind;
+    n->atom = atom;
+    n->id = 0;
+    n->left = l;
+    n->right = r;
+    return n;
+}
+
+/* Complete implication tree with `nodes` nodes (nodes must be 2^k - 1). */
+static Node *gen_balanced(size_t nodes, unsigned *atom) {
+    if (nodes <= 1) return mk_node('A', (char)('P' + (*atom)++ % 8), NULL, NULL);
+    Node *l = gen_balanced(nodes / 2, atom);
+    Node *r = gen_balanced(nodes / 2, atom);
+    return mk_node('C', 0, l, r);
+}
+
+/* Right comb cAcBc...Z with `nodes` nodes (odd), built iteratively. */
+static Node *gen_comb(size_t nodes) {
+    size_t pairs = nodes / 2;
+    Node *n = mk_node('A', (char)('P' + pairs % 8), NULL, NULL);
+    for (size_t i = pairs; i-- > 0;)
+        n = mk_node('C', 0, mk_node('A', (char)('P' + i % 8), NULL, NULL), n);
+    return n;
+}
+
+static Node *gen_shape(const char *shape, size_t nodes) {
+    unsigned atom = 0;
+    return strcmp(shape, "comb") == 0 ? gen_comb(nodes) : gen_balanced(nodes, &atom);
+}
+
+static size_t tree_depth(const Node *n) {
+    size_t d = 0;
+    while (n) {   // both shapes are deepest along the right spine
+        d++;
+        n = n->right ? n->right : n->left;
+    }
+    return d;
+}
+
+static char *tree_string(const Node *n) {
+    size_t len = tree_size(n);
+    char *s = malloc(len + 1);
+    if (!s) { perror("malloc"); exit(EXIT_FAILURE); }
+    s[tree_to_prefix(n, s)] = '\0';
+    return s;
+}
+
+/* ---------------- Cases ---------------- */
+
+/* Per-kernel inputs are built just before that kernel runs and dropped
+   after it, so a multi-million-node case holds only a few copies of f. */
+typedef struct {
+    Node *f;          // the formula
+    char *text;       // f in prefix form
+    Node *g;          // equal_tree: a separately allocated copy of f
+    Node *inst;       // match_pattern: an instance of the axiom built from f
+    Node *mp_cur;     // check_modus_ponens: the conclusion (lines 1, 2 hold f, cfP)
+    Node *repl;       // subst_equal: the replacement for P ...
+    Node *subst;      // ... and f with P replaced by it
+    Node **out;       // results to free after a timed repetition
+} Fixture;
+
+typedef void (*KernelFn)(Fixture *fx, long iters);
+
+static void k_parse_node(Fixture *fx, long iters) {
+    for (long i = 0; i < iters; ++i) {
+        int idx = 0;
+        fx->out[i] = parse_node(fx->text, &idx);
+    }
+}
+
+static void k_is_wff_str(Fixture *fx, long iters) {
+    uintptr_t acc = 0;
+    for (long i = 0; i < iters; ++i) acc += (uintptr_t)is_wff_str(fx->text);
+    g_sink += acc;
+}
+
+static void k_equal_tree(Fixture *fx, long iters) {
+    uintptr_t acc = 0;
+    for (long i = 0; i < iters; ++i) acc += (uintptr_t)equal_tree(fx->f, fx->g);
+    g_sink += acc;
+}
+
+static Node *axiom_matcher(int k) {
+    Node *probe = mk_node('A', 'P', NULL, NULL);
+    if (k == 1) is_instance_AX1(probe);
+    else if (k == 2) is_instance_AX2(probe);
+    else is_instance_AX3(probe);
+    free_tree(probe);
+    return atomic_load(k == 1 ? &AX1_MATCHER : k == 2 ? &AX2_MATCHER : &AX3_MATCHER);
+}
+
+static void k_match(Fixture *fx, long iters, int k) {
+    Node *pat = axiom_matcher(k);
+    uintptr_t acc = 0;
+    for (long i = 0; i < iters; ++i) {
+        Bindings b;
+        bindings_init(&b);
+        acc += (uintptr_t)match_pattern_rec(pat, fx->inst, &b);
+    }
+    g_sink += acc;
+}
+static void k_match_ax1(Fixture *fx, long iters) { k_match(fx, iters, 1); }
+static void k_match_ax2(Fixture *fx, long iters) { k_match(fx, iters, 2); }
+static void k_match_ax3(Fixture *fx, long iters) { k_match(fx, iters, 3); }
+
+static void k_subst_equal(Fixture *fx, long iters) {
+    uintptr_t acc = 0;
+    for (long i = 0; i < iters; ++i) acc += (uintptr_t)subst_equal(fx->f, 'P', fx->repl, fx->subst);
+    g_sink += acc;
+}
+
+static void k_modus_ponens(Fixture *fx, long iters) {
+    uintptr_t acc = 0;
+    for (long i = 0; i < iters; ++i) acc += (uintptr_t)check_modus_ponens(fx->mp_cur, 1, 2);
+    g_sink += acc;
+}
+
+/* Axiom instances whose pattern variables P and Q are bound to copies of f,
+   so matching does a full equal_tree on each repeated variable. */
+static Node *build_instance(const Node *f, int k) {
+    Node *S = mk_node('A', 'S', NULL, NULL);
+    Node *inst;
+    if (k == 1)        /* cPcQP */
+        inst = mk_node('C', 0, clone_tree(f), mk_node('C', 0, clone_tree(f), clone_tree(f)));
+    else if (k == 2)   /* ccScPQccSPcSQ */
+        inst = mk_node('C', 0,
+            mk_node('C', 0, clone_tree(S), mk_node('C', 0, clone_tree(f), clone_tree(f))),
+            mk_node('C', 0, mk_node('C', 0, clone_tree(S), clone_tree(f)),
+                            mk_node('C', 0, clone_tree(S), clone_tree(f))));
+    else               /* ccnPnQcQP */
+        inst = mk_node('C', 0,
+            mk_node('C', 0, mk_node('N', 0, clone_tree(f), NULL), mk_node('N', 0, clone_tree(f), NULL)),
+            mk_node('C', 0, clone_tree(f), clone_tree(f)));
+    free_tree(S);
+    return inst;
+}
+
+/* p with every P replaced by a copy of r. */
+static Node *subst_tree(const Node *p, const Node *r) {
+    if (p->kind == 'A') return p->atom == 'P' ? clone_tree(r) : mk_node('A', p->atom, NULL, NULL);
+    return mk_node(p->kind, 0, subst_tree(p->left, r), p->right ? subst_tree(p->right, r) : NULL);
+}
+
+enum { NEED_NONE, NEED_COPY, NEED_AX1, NEED_AX2, NEED_AX3, NEED_MP, NEED_REPL };
+
+static void fixture_prepare(Fixture *fx, int need) {
+    switch (need) {
+    case NEED_COPY: fx->g = clone_tree(fx->f); break;
+    case NEED_AX1: case NEED_AX2: case NEED_AX3:
+        fx->inst = build_instance(fx->f, need - NEED_AX1 + 1);
+        break;
+    case NEED_MP:
+        /* lines 1: f and 2: c f P, so MP 1 2 yields P after comparing f */
+        ensure_proof_capacity();
+        memset(&proof[0], 0, 2 * sizeof(ProofLine));
+        proof[0].formula_ast = clone_tree(fx->f);
+        proof[1].formula_ast = mk_node('C', 0, clone_tree(fx->f), mk_node('A', 'P', NULL, NULL));
+        proof_count = 2;
+        fx->mp_cur = mk_node('A', 'P', NULL, NULL);
+        break;
+    case NEED_REPL:
+        fx->repl = gen_shape("balanced", 7);
+        fx->subst = subst_tree(fx->f, fx->repl);
+        break;
+    }
+}
+
+static void fixture_release(Fixture *fx) {
+    free_tree(fx->g);
+    free_tree(fx->inst);
+    free_tree(fx->mp_cur);
+    free_tree(fx->repl);
+    free_tree(fx->subst);
+    fx->g = fx->inst = fx->mp_cur = fx->repl = fx->subst = NULL;
+    cleanup_proof();
+}
+
+typedef struct {
+    const char *name;
+    KernelFn fn;
+    int need;         // extra input built by fixture_prepare
+    int allocates;    // fills fx->out[0..iters)
+} Kernel;
+
+static const Kernel KERNELS[] = {
+    { "parse_node",         k_parse_node,   NEED_NONE, 1 },
+    { "is_wff_str",         k_is_wff_str,   NEED_NONE, 0 },
+    { "equal_tree",         k_equal_tree,   NEED_COPY, 0 },
+    { "match_pattern/ax1",  k_match_ax1,    NEED_AX1,  0 },
+    { "match_pattern/ax2",  k_match_ax2,    NEED_AX2,  0 },
+    { "match_pattern/ax3",  k_match_ax3,    NEED_AX3,  0 },
+    { "subst_equal",        k_subst_equal,  NEED_REPL, 0 },
+    { "check_modus_ponens", k_modus_ponens, NEED_MP,   0 },
+};
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void free_outputs(Fixture *fx, long iters) {
+    for (long i = 0; i < iters; ++i) {
+        free_tree(fx->out[i]);
+        fx->out[i] = NULL;
+    }
+}
+
+static double time_once(const Kernel *k, Fixture *fx, long iters) {
+    double t0 = bench_now_ns();
+    k->fn(fx, iters);
+    double t = bench_now_ns() - t0;
+    if (k->allocates) free_outputs(fx, iters);
+    return t;
+}
+
+static void run_case(const Kernel *k, const char *shape, Fixture *fx, size_t nodes, size_t depth) {
+    char name[128];
+    snprintf(name, sizeof name, "%s/%s/%zu", k->name, shape, nodes);
+    if (g_opts.filter && !strstr(name, g_opts.filter)) return;
+    fixture_prepare(fx, k->need);
+
+    /* calibrate: double iters until one repetition fills min_ns */
+    long iters = 1;
+    fx->out = calloc(1, sizeof(Node*));
+    double t = time_once(k, fx, iters);   // also warms caches and matchers
+    while (t < g_opts.min_ns && iters < (1L << 24)) {
+        iters *= 2;
+        free(fx->out);
+        fx->out = calloc((size_t)iters, sizeof(Node*));
+        if (!fx->out) { perror("calloc"); exit(EXIT_FAILURE); }
+        t = time_once(k, fx, iters);
+    }
+
+    int reps = g_opts.reps;
+    double *per = malloc((size_t)reps * sizeof(double));
+    if (!per) { perror("malloc"); exit(EXIT_FAILURE); }
+    double sum = 0;
+    for (int r = 0; r < reps; ++r) {
+        per[r] = time_once(k, fx, iters) / (double)iters;
+        sum += per[r];
+    }
+    double mean = sum / reps, var = 0;
+    for (int r = 0; r < reps; ++r) var += (per[r] - mean) * (per[r] - mean);
+    double stddev = reps > 1 ? sqrt(var / (reps - 1)) : 0;
+    qsort(per, (size_t)reps, sizeof(double), cmp_double);
+    double median = reps % 2 ? per[reps / 2] : (per[reps / 2 - 1] + per[reps / 2]) / 2;
+    int p99 = (int)ceil(0.99 * reps) - 1;
+
+    printf("{\"name\":\"%s\",\"kernel\":\"%s\",\"shape\":\"%s\",\"nodes\":%zu,\"depth\":%zu,"
+           "\"iters\":%ld,\"reps\":%d,\"mean_ns\":%.2f,\"stddev_ns\":%.2f,\"min_ns\":%.2f,"
+           "\"median_ns\":%.2f,\"p99_ns\":%.2f,\"max_ns\":%.2f}\n",
+           name, k->name, shape, nodes, depth, iters, reps, mean, stddev, per[0],
+           median, per[p99 < 0 ? 0 : p99], per[reps - 1]);
+    fflush(stdout);
+    free(per);
+    free(fx->out);
+    fx->out = NULL;
+    fixture_release(fx);
+}
+
+static void *bench_main(void *arg) {
+    (void)arg;
+    static const char *SHAPES[] = { "balanced", "comb" };
+    for (size_t s = 0; s < sizeof SHAPES / sizeof *SHAPES; ++s) {
+        for (size_t nodes = 1; nodes <= g_opts.max_nodes; nodes = nodes * 16 + 15) {
+            Fixture fx;
+            memset(&fx, 0, sizeof fx);
+            fx.f = gen_shape(SHAPES[s], nodes);
+            fx.text = tree_string(fx.f);
+            size_t depth = tree_depth(fx.f);
+            for (size_t k = 0; k < sizeof KERNELS / sizeof *KERNELS; ++k)
+                run_case(&KERNELS[k], SHAPES[s], &fx, nodes, depth);
+            free_tree(fx.f);
+            free(fx.text);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) g_opts.reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-nodes") == 0 && i + 1 < argc) g_opts.max_nodes = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) g_opts.min_ns = atof(argv[++i]) * 1e6;
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) g_opts.filter = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--reps R] [--max-nodes N] [--min-ms T] [--filter SUBSTR]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (g_opts.reps < 1) g_opts.reps = 1;
+
+    /* recursion depth is proportional to formula depth: give deep combs room */
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, (size_t)1 << 30);
+    pthread_t t;
+    if (pthread_create(&t, &attr, bench_main, NULL) != 0) { perror("pthread_create"); return 1; }
+    pthread_join(t, NULL);
+    pthread_attr_destroy(&attr);
+    return 0;
+}
@@ -0,0 +1,266 @@
+// bench_phases.c
+// Per-phase cost of verifying real proofs: reading (read_proof_from_span),
+// parsing (parse_all_formulas, line by line) and checking (check_proof, line
+// by line), with hardware counters from perf_event_open when available.
+//
+// Build (the phases are static, so the checker source is included directly):
+//  gcc -std=c11 -O2 -Wall -o bench_phases bench_phases.c
+//
+// Run:
+//  ./bench_phases [--reps R] [--per-line] [--no-counters] PROOF_OR_DIR...
+//
+// Output is JSON lines. One record per proof:
+//   {"proof":"p.txt","bytes":..,"lines":..,"rc":0,"reps":5,
+//    "read":{"ns":..,"cycles":..,"instructions":..,"cache_misses":..,"branch_misses":..},
+//    "parse":{..},"check":{..}}
+// and with --per-line one more record per line of each proof:
+//   {"proof":"p.txt","line":3,"rule":"MP","parse":{..},"check":{..}}
+// Values are means over --reps runs. Counters are user-space only and come
+// from one perf event group (cycles, instructions, cache misses, branch
+// misses); where the kernel or the VM does not expose them (perf_event_paranoid,
+// no PMU) they are reported as null and only "ns" is filled in. Reading the
+// group costs a system call, so per-line figures for tiny lines are dominated
+// by that overhead; compare them against each other rather than in absolute
+// terms. The phases are the ones run_verify itself runs: its phase hook
+// samples around them, so the figures follow any change to run_verify.
+
+#include "proof_checker.c"
+
+#include <dirent.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* ---------------- Counters ---------------- */
+
+enum { CTR_CYCLES, CTR_INSTRUCTIONS, CTR_CACHE_MISSES, CTR_BRANCH_MISSES, CTR_COUNT };
+
+static const char *CTR_NAMES[CTR_COUNT] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+static const uint64_t CTR_CONFIG[CTR_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static int g_ctr_fd[CTR_COUNT] = { -1, -1, -1, -1 };
+static int g_ctr_ok;
+
+static void counters_open(void) {
+    for (int c = 0; c < CTR_COUNT; ++c) {
+        struct perf_event_attr a;
+        memset(&a, 0, sizeof a);
+        a.type = PERF_TYPE_HARDWARE;
+        a.size = sizeof a;
+        a.config = CTR_CONFIG[c];
+        a.exclude_kernel = 1;
+        a.exclude_hv = 1;
+        a.read_format = PERF_FORMAT_GROUP;
+        int leader = c == 0 ? -1 : g_ctr_fd[0];
+        g_ctr_fd[c] = (int)syscall(__NR_perf_event_open, &a, 0, -1, leader, 0);
+        if (g_ctr_fd[c] < 0) {
+            for (int k = 0; k < c; ++k) close(g_ctr_fd[k]);
+            for (int k = 0; k < CTR_COUNT; ++k) g_ctr_fd[k] = -1;
+            return;
+        }
+    }
+    g_ctr_ok = 1;
+}
+
+typedef struct {
+    double ns;
+    uint64_t ctr[CTR_COUNT];
+} Sample;
+
+static void sample_now(Sample *s) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    s->ns = (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+    memset(s->ctr, 0, sizeof s->ctr);
+    if (g_ctr_ok) {
+        uint64_t buf[1 + CTR_COUNT];
+        if (read(g_ctr_fd[0], buf, sizeof buf) == (ssize_t)sizeof buf)
+            memcpy(s->ctr, buf + 1, sizeof s->ctr);
+    }
+}
+
+/* Accumulated cost of a phase over all repetitions. */
+typedef struct {
+    double ns;
+    double ctr[CTR_COUNT];
+} Cost;
+
+static void cost_add(Cost *c, const Sample *a, const Sample *b) {
+    c->ns += b->ns - a->ns;
+    for (int k = 0; k < CTR_COUNT; ++k) c->ctr[k] += (double)(b->ctr[k] - a->ctr[k]);
+}
+
+static void cost_print(const char *name, const Cost *c, int reps) {
+    printf("\"%s\":{\"ns\":%.0f", name, c->ns / reps);
+    for (int k = 0; k < CTR_COUNT; ++k) {
+        if (g_ctr_ok) printf(",\"%s\":%.0f", CTR_NAMES[k], c->ctr[k] / reps);
+        else printf(",\"%s\":null", CTR_NAMES[k]);
+    }
+    printf("}");
+}
+
+/* ---------------- One proof ---------------- */
+
+typedef struct {
+    Cost read, parse, check;
+    Cost *line_parse, *line_check;
+    Rule *line_rule;
+    int lines;
+    int rc;
+} ProofCost;
+
+static int g_reps = 5;
+static int g_per_line;
+
+typedef struct {
+    ProofCost *pc;
+    int first;            // first repetition: size the per-line arrays
+    Sample phase, line;   // samples taken on entering the phase and the line
+} PhaseCtx;
+
+/* run_verify's phase hook: sample around each phase, and around each line
+   with --per-line (otherwise the phase totals carry no per-line sampling). */
+static void on_phase(void *ctx, int phase, int line, int end) {
+    PhaseCtx *c = (PhaseCtx*)ctx;
+    ProofCost *pc = c->pc;
+    if (line >= 0 && (!g_per_line || !pc->line_parse)) return;
+    if (!end) {
+        if (phase == PC_HIST_PARSE_NS && line < 0) {
+            pc->lines = proof_count;
+            if (c->first && g_per_line) {
+                pc->line_parse = calloc((size_t)proof_count, sizeof(Cost));
+                pc->line_check = calloc((size_t)proof_count, sizeof(Cost));
+                pc->line_rule = calloc((size_t)proof_count, sizeof(Rule));
+                if (!pc->line_parse || !pc->line_check || !pc->line_rule) { perror("calloc"); exit(EXIT_FAILURE); }
+            }
+        }
+        sample_now(line < 0 ? &c->phase : &c->line);
+        return;
+    }
+    Sample now;
+    sample_now(&now);
+    if (line >= 0) {
+        if (phase == PC_HIST_PARSE_NS) {
+            cost_add(&pc->line_parse[line], &c->line, &now);
+        } else {
+            cost_add(&pc->line_check[line], &c->line, &now);
+            pc->line_rule[line] = proof[line].rule;
+        }
+        return;
+    }
+    cost_add(phase == PC_HIST_TOKENIZE_NS ? &pc->read : phase == PC_HIST_PARSE_NS ? &pc->parse : &pc->check,
+             &c->phase, &now);
+}
+
+/* Verify once through run_verify with the phase hook set; returns its
+   return code. */
+static int measure_once(const char *text, size_t len, ProofCost *pc, int first) {
+    PhaseCtx c;
+    memset(&c, 0, sizeof c);
+    c.pc = pc;
+    c.first = first;
+    g_phase_hook = on_phase;
+    g_phase_ctx = &c;
+    char *out = NULL;
+    int rc = run_verify(text, len, &out);
+    g_phase_hook = NULL;
+    g_phase_ctx = NULL;
+    free_output(out);
+    return rc;
+}
+
+static int json_quote_path(StrBuf *sb, const char *s) {
+    if (!sb_appendf(sb, "\"")) return 0;
+    for (; *s; ++s) {
+        unsigned char ch = (unsigned char)*s;
+        int ok = ch == '"' || ch == '\\' ? sb_appendf(sb, "\\%c", ch)
+               : ch < 0x20 ? sb_appendf(sb, "\\u%04x", ch)
+               : sb_appendf(sb, "%c", ch);
+        if (!ok) return 0;
+    }
+    return sb_appendf(sb, "\"");
+}
+
+static void measure_proof(const char *path, const char *text, size_t len) {
+    ProofCost pc;
+    memset(&pc, 0, sizeof pc);
+    for (int r = 0; r < g_reps; ++r) pc.rc = measure_once(text, len, &pc, r == 0);
+
+    StrBuf sb;
+    if (!sb_init(&sb) || !json_quote_path(&sb, path)) { perror("malloc"); exit(EXIT_FAILURE); }
+    printf("{\"proof\":%s,\"bytes\":%zu,\"lines\":%d,\"rc\":%d,\"reps\":%d,", sb.buf, len, pc.lines, pc.rc, g_reps);
+    cost_print("read", &pc.read, g_reps);
+    putchar(',');
+    cost_print("parse", &pc.parse, g_reps);
+    putchar(',');
+    cost_print("check", &pc.check, g_reps);
+    printf("}\n");
+    for (int i = 0; g_per_line && i < pc.lines; ++i) {
+        printf("{\"proof\":%s,\"line\":%d,\"rule\":\"%s\",", sb.buf, i + 1, RULE_NAMES[pc.line_rule[i]]);
+        cost_print("parse", &pc.line_parse[i], g_reps);
+        putchar(',');
+        cost_print("check", &pc.line_check[i], g_reps);
+        printf("}\n");
+    }
+    sb_free(&sb);
+    free(pc.line_parse);
+    free(pc.line_check);
+    free(pc.line_rule);
+}
+
+static void measure_path(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) { fprintf(stderr, "%s: %s\n", path, strerror(errno)); return; }
+    if (S_ISDIR(st.st_mode)) {
+        struct dirent **names;
+        int n = scandir(path, &names, NULL, alphasort);
+        for (int i = 0; i < n; ++i) {
+            if (names[i]->d_name[0] != '.') {
+                char sub[4096];
+                snprintf(sub, sizeof sub, "%s/%s", path, names[i]->d_name);
+                measure_path(sub);
+            }
+            free(names[i]);
+        }
+        if (n >= 0) free(names);
+        return;
+    }
+    FILE *f = fopen(path, "rb");
+    if (!f) { fprintf(stderr, "%s: %s\n", path, strerror(errno)); return; }
+    char *text = malloc((size_t)st.st_size + 1);
+    if (!text) { perror("malloc"); exit(EXIT_FAILURE); }
+    size_t len = fread(text, 1, (size_t)st.st_size, f);
+    fclose(f);
+    text[len] = '\0';
+    measure_proof(path, text, len);
+    free(text);
+}
+
+int main(int argc, char **argv) {
+    int counters = 1, n_paths = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) g_reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--per-line") == 0) g_per_line = 1;
+        else if (strcmp(argv[i], "--no-counters") == 0) counters = 0;
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [--reps R] [--per-line] [--no-counters] PROOF_OR_DIR...\n", argv[0]);
+            return 2;
+        }
+        else n_paths++;
+    }
+    if (g_reps < 1) g_reps = 1;
+    if (counters) {
+        counters_open();
+        if (!g_ctr_ok) fprintf(stderr, "bench_phases: hardware counters unavailable (%s), timing only\n", strerror(errno));
+    }
+    if (n_paths == 0) { fprintf(stderr, "bench_phases: no proofs given\n"); return 2; }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--reps") == 0) { i++; continue; }
+        if (argv[i][0] != '-') measure_path(argv[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,470 @@
+// fuzz_verify.c
+// Algorithmic-complexity fuzzer for verify_proof: searches for inputs that
+// make the checker do the most work per input byte, and keeps the worst of
+// them as a regression corpus.
+//
+// Standalone build (gcc; the checker is compiled with trace-pc coverage so
+// the fuzzer also rewards inputs that reach new code):
+//  gcc -std=c11 -O2 -fsanitize-coverage=trace-pc -c proof_checker.c -o proof_checker_cov.o
+//  gcc -std=c11 -O2 -Wall -o fuzz_verify fuzz_verify.c proof_checker_cov.o
+//
+// libFuzzer build (coverage comes from libFuzzer; cost levels are fed back
+// as extra counters, so a new cost-per-byte plateau counts as new coverage):
+//  clang -std=c11 -O2 -g -fsanitize=fuzzer,address -DPC_LIBFUZZER -o fuzz_verify_lf fuzz_verify.c proof_checker.c
+//  ./fuzz_verify_lf -max_len=4096 fuzz_corpus/
+//
+// Standalone run:
+//  ./fuzz_verify [--seconds S] [--runs N] [--max-len B] [--seed X] [--out DIR] [SEED_DIR...]
+//  ./fuzz_verify --replay DIR      (cost per byte of every file in DIR, as JSON lines)
+//
+// Cost is user-space instructions retired (perf_event_open) when the kernel
+// allows it, and thread CPU time in ns otherwise. The worst offenders by
+// cost per byte are written to DIR (default fuzz_corpus/) as slow-NN.txt.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "proof_checker.h"
+
+/* ---------------- Cost measurement ---------------- */
+
+static int g_perf_fd = -1;
+
+static void cost_init(void) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof a);
+    a.type = PERF_TYPE_HARDWARE;
+    a.size = sizeof a;
+    a.config = PERF_COUNT_HW_INSTRUCTIONS;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    g_perf_fd = (int)syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+static const char *cost_unit(void) { return g_perf_fd >= 0 ? "instructions" : "cpu_ns"; }
+
+static uint64_t cost_now(void) {
+    if (g_perf_fd >= 0) {
+        uint64_t v;
+        if (read(g_perf_fd, &v, sizeof v) == (ssize_t)sizeof v) return v;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Work per byte; short inputs are charged as 16 bytes so the fixed cost of
+   a call does not make one-character inputs look pathological. */
+static double cost_score(uint64_t cost, size_t len) {
+    return (double)cost / (double)(len < 16 ? 16 : len);
+}
+
+static uint64_t run_input(const char *data, size_t len) {
+    char *out = NULL;
+    uint64_t t0 = cost_now();
+    verify_proof_n(data, len, &out);
+    uint64_t t = cost_now() - t0;
+    free_output(out);
+    return t;
+}
+
+#ifdef PC_LIBFUZZER
+
+/* One extra counter per power-of-two cost-per-byte level. */
+__attribute__((section("__libfuzzer_extra_counters")))
+static uint8_t g_cost_levels[64];
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static int init;
+    if (!init) { cost_init(); init = 1; }
+    double score = cost_score(run_input((const char*)data, size), size);
+    int level = 0;
+    while (score >= 2.0 && level < 63) { score /= 2.0; level++; }
+    g_cost_levels[level] = 1;
+    return 0;
+}
+
+#else
+
+/* Fastest of `reps` runs: CPU time is noisy, and one preempted run must not
+   make a trivial input look slow. */
+static uint64_t measure(const char *data, size_t len, int reps) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < reps; ++r) {
+        uint64_t c = run_input(data, len);
+        if (c < best) best = c;
+    }
+    return best;
+}
+
+/* ---------------- Coverage (trace-pc) ---------------- */
+
+/* proof_checker.c compiled with -fsanitize-coverage=trace-pc calls this on
+   every basic block; the caller's address is hashed into a small bitmap. */
+#define COV_BITS 16
+static uint8_t g_cov[1u << COV_BITS];      // edges seen in the current run
+static uint8_t g_cov_all[1u << COV_BITS];  // edges seen by any kept input
+static int g_cov_enabled;
+
+void __sanitizer_cov_trace_pc(void) {
+    uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+    g_cov[(pc ^ (pc >> COV_BITS)) & ((1u << COV_BITS) - 1)] = 1;
+    g_cov_enabled = 1;
+}
+
+static int cov_merge_new(void) {
+    int fresh = 0;
+    for (size_t i = 0; i < sizeof g_cov; ++i) {
+        if (g_cov[i] && !g_cov_all[i]) { g_cov_all[i] = 1; fresh++; }
+        g_cov[i] = 0;
+    }
+    return fresh;
+}
+
+/* ---------------- Corpus ---------------- */
+
+typedef struct {
+    char *data;
+    size_t len;
+    double score;
+} Input;
+
+typedef struct {
+    Input *v;
+    size_t n, cap;
+} InputSet;
+
+static void set_add(InputSet *s, const char *data, size_t len, double score) {
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 64;
+        s->v = realloc(s->v, s->cap * sizeof(Input));
+        if (!s->v) { perror("realloc"); exit(EXIT_FAILURE); }
+    }
+    Input *in = &s->v[s->n++];
+    in->data = malloc(len + 1);
+    if (!in->data) { perror("malloc"); exit(EXIT_FAILURE); }
+    memcpy(in->data, data, len);
+    in->data[len] = '\0';
+    in->len = len;
+    in->score = score;
+}
+
+#define WORST_KEEP 16
+static Input g_worst[WORST_KEEP];
+static int g_worst_n;
+
+/* Keep the WORST_KEEP highest-scoring inputs. Returns 1 if data got in. */
+static int worst_offer(const char *data, size_t len, double score) {
+    int slot = g_worst_n < WORST_KEEP ? g_worst_n++ : -1;
+    if (slot < 0) {
+        slot = 0;
+        for (int i = 1; i < WORST_KEEP; ++i)
+            if (g_worst[i].score < g_worst[slot].score) slot = i;
+        if (g_worst[slot].score >= score) return 0;
+        free(g_worst[slot].data);
+    }
+    g_worst[slot].data = malloc(len + 1);
+    if (!g_worst[slot].data) { perror("malloc"); exit(EXIT_FAILURE); }
+    memcpy(g_worst[slot].data, data, len);
+    g_worst[slot].data[len] = '\0';
+    g_worst[slot].len = len;
+    g_worst[slot].score = score;
+    return 1;
+}
+
+static double worst_floor(void) {
+    if (g_worst_n < WORST_KEEP) return 0;
+    double m = g_worst[0].score;
+    for (int i = 1; i < WORST_KEEP; ++i) if (g_worst[i].score < m) m = g_worst[i].score;
+    return m;
+}
+
+static int cmp_score_desc(const void *a, const void *b) {
+    double x = ((const Input*)a)->score, y = ((const Input*)b)->score;
+    return (x < y) - (x > y);
+}
+
+static void worst_save(const char *dir) {
+    mkdir(dir, 0777);
+    qsort(g_worst, (size_t)g_worst_n, sizeof(Input), cmp_score_desc);
+    for (int i = 0; i < g_worst_n; ++i) {
+        char path[4096];
+        snprintf(path, sizeof path, "%s/slow-%02d.txt", dir, i);
+        FILE *f = fopen(path, "wb");
+        if (!f) { fprintf(stderr, "%s: %s\n", path, strerror(errno)); continue; }
+        fwrite(g_worst[i].data, 1, g_worst[i].len, f);
+        fclose(f);
+    }
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096, n = 0;
+    char *buf = malloc(cap);
+    size_t k;
+    while (buf && (k = fread(buf + n, 1, cap - n, f)) > 0) {
+        n += k;
+        if (n == cap) buf = realloc(buf, cap *= 2);
+    }
+    fclose(f);
+    *len = n;
+    return buf;
+}
+
+/* Call fn on every regular file in dir, in name order. */
+static void for_each_file(const char *dir, void (*fn)(const char *path, const char *data, size_t len, void *ctx), void *ctx) {
+    struct dirent **names;
+    int n = scandir(dir, &names, NULL, alphasort);
+    if (n < 0) { fprintf(stderr, "%s: %s\n", dir, strerror(errno)); return; }
+    for (int i = 0; i < n; ++i) {
+        char path[4096];
+        snprintf(path, sizeof path, "%s/%s", dir, names[i]->d_name);
+        struct stat st;
+        size_t len;
+        char *data;
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && (data = read_file(path, &len))) {
+            fn(path, data, len, ctx);
+            free(data);
+        }
+        free(names[i]);
+    }
+    free(names);
+}
+
+/* ---------------- Mutation ---------------- */
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rnd(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+static size_t rnd_below(size_t n) { return n ? (size_t)(rnd() % n) : 0; }
+
+static const char *SEEDS[] = {
+    "1 cPQ Premise\n2 P Premise\n3 Q MP 2 1\n",
+    "1 cPcQP AX1\n2 ccPcQPcPQ AX1\n",
+    "1 ccPcQRccPQcPR AX2\n",
+    "1 ccnPnQcQP AX3\n",
+    "1 cPcQP AX1\n2 cRcQR Substitution P=R\n",
+    "1 cPccPPP AX1\n2 ccPccPPPccPcPPcPP AX2\n3 ccPcPPcPP MP 1 2\n4 cPcPP AX1\n5 cPP MP 4 3\n",
+    "1 *cPP AX1\n2 c$1$1 Substitution P=cPP\n3 @2 Lemma\n",
+    "1 ccPQcPQ AX1\n2 ccPQcPQ Lemma\n",
+};
+
+static const char *TOKENS[] = {
+    "c", "n", "P", "Q", "R", "S", " ", "\n", "1", "2", "9",
+    " Premise", " AX1", " AX2", " AX3", " MP 1 2", " MP 2 1", " Lemma",
+    " Substitution P=", " Substitution Q=cPQ", "@1", "*", "$1", "cc", "nn",
+};
+
+/* A random formula with roughly `size` symbols. */
+static void gen_formula(char *buf, size_t *n, size_t cap, size_t size) {
+    if (*n >= cap) return;
+    if (size <= 1 || *n + 3 >= cap) { buf[(*n)++] = (char)('P' + rnd_below(4)); return; }
+    if (rnd_below(5) == 0) { buf[(*n)++] = 'n'; gen_formula(buf, n, cap, size - 1); return; }
+    buf[(*n)++] = 'c';
+    size_t l = 1 + rnd_below(size - 1);
+    gen_formula(buf, n, cap, l);
+    gen_formula(buf, n, cap, size - l);
+}
+
+static size_t count_lines(const char *d, size_t len) {
+    size_t k = 1;
+    for (size_t i = 0; i < len; ++i) k += d[i] == '\n';
+    return k;
+}
+
+/* Mutate buf[0..len) in place (buf has room for cap bytes); returns the new length. */
+static size_t mutate(char *buf, size_t len, size_t cap, const InputSet *corpus) {
+    char tmp[512];
+    size_t tn = 0;
+    switch (rnd_below(8)) {
+    case 0:   /* overwrite a byte with a token */
+    case 1: { /* insert a token */
+        const char *t = TOKENS[rnd_below(sizeof TOKENS / sizeof *TOKENS)];
+        tn = strlen(t);
+        memcpy(tmp, t, tn);
+        break;
+    }
+    case 2: { /* delete a range */
+        if (len == 0) return len;
+        size_t at = rnd_below(len), k = 1 + rnd_below(len - at < 16 ? len - at : 16);
+        memmove(buf + at, buf + at + k, len - at - k);
+        return len - k;
+    }
+    case 3: { /* duplicate a range */
+        if (len == 0) return len;
+        size_t at = rnd_below(len);
+        tn = 1 + rnd_below(len - at < sizeof tmp ? len - at : sizeof tmp);
+        memcpy(tmp, buf + at, tn);
+        break;
+    }
+    case 4: { /* splice in part of another corpus entry */
+        const Input *o = &corpus->v[rnd_below(corpus->n)];
+        if (o->len == 0) return len;
+        size_t at = rnd_below(o->len);
+        tn = 1 + rnd_below(o->len - at < sizeof tmp ? o->len - at : sizeof tmp);
+        memcpy(tmp, o->data + at, tn);
+        break;
+    }
+    case 5: { /* append a generated line citing earlier lines */
+        size_t lines = count_lines(buf, len);
+        tn = (size_t)snprintf(tmp, sizeof tmp, "%zu ", lines);
+        gen_formula(tmp, &tn, 200, 1 + rnd_below(64));
+        static const char *J[] = { " AX1", " AX2", " AX3", " Premise", " Lemma" };
+        int r = (int)rnd_below(7);
+        if (r < 5) tn += (size_t)snprintf(tmp + tn, sizeof tmp - tn, "%s\n", J[r]);
+        else if (r == 5) tn += (size_t)snprintf(tmp + tn, sizeof tmp - tn, " MP %zu %zu\n",
+                                               1 + rnd_below(lines), 1 + rnd_below(lines));
+        else {
+            tn += (size_t)snprintf(tmp + tn, sizeof tmp - tn, " Substitution %c=", (char)('P' + rnd_below(4)));
+            gen_formula(tmp, &tn, sizeof tmp - 2, 1 + rnd_below(64));
+            tmp[tn++] = '\n';
+        }
+        if (len + tn > cap) return len;
+        memcpy(buf + len, tmp, tn);
+        return len + tn;
+    }
+    case 6: { /* grow a formula: replace an atom with a random subformula */
+        size_t at = rnd_below(len + 1);
+        while (at < len && (buf[at] < 'P' || buf[at] > 'S')) at++;
+        if (at >= len) return len;
+        gen_formula(tmp, &tn, sizeof tmp, 2 + rnd_below(32));
+        if (len - 1 + tn > cap) return len;
+        memmove(buf + at + tn, buf + at + 1, len - at - 1);
+        memcpy(buf + at, tmp, tn);
+        return len - 1 + tn;
+    }
+    default: { /* repeat the last line */
+        size_t end = len;
+        while (end > 0 && buf[end - 1] == '\n') end--;
+        size_t start = end;
+        while (start > 0 && buf[start - 1] != '\n') start--;
+        tn = end - start < sizeof tmp - 1 ? end - start : sizeof tmp - 1;
+        memcpy(tmp, buf + start, tn);
+        tmp[tn++] = '\n';
+        if (len + tn > cap) return len;
+        if (len > 0 && buf[len - 1] != '\n') buf[len++] = '\n';
+        memcpy(buf + len, tmp, tn);
+        return len + tn > cap ? cap : len + tn;
+    }
+    }
+    size_t at = rnd_below(len + 1);
+    if (tn == 0 || len + tn > cap) return len;
+    if (rnd_below(2) == 0 && at + tn <= len) {   /* overwrite */
+        memcpy(buf + at, tmp, tn);
+        return len;
+    }
+    memmove(buf + at + tn, buf + at, len - at);
+    memcpy(buf + at, tmp, tn);
+    return len + tn;
+}
+
+/* ---------------- Driver ---------------- */
+
+static void add_seed_file(const char *path, const char *data, size_t len, void *ctx) {
+    (void)path;
+    InputSet *corpus = ctx;
+    set_add(corpus, data, len, cost_score(measure(data, len, 3), len));
+    cov_merge_new();
+}
+
+static void replay_file(const char *path, const char *data, size_t len, void *ctx) {
+    (void)ctx;
+    uint64_t best = measure(data, len, 5);
+    printf("{\"name\":\"fuzz/%s\",\"bytes\":%zu,\"cost\":%llu,\"unit\":\"%s\",\"cost_per_byte\":%.1f}\n",
+           strrchr(path, '/') ? strrchr(path, '/') + 1 : path, len,
+           (unsigned long long)best, cost_unit(), cost_score(best, len));
+}
+
+int main(int argc, char **argv) {
+    double seconds = 60;
+    long runs = -1;
+    size_t max_len = 4096;
+    const char *out_dir = "fuzz_corpus";
+    const char *seed_dirs[16];
+    int n_seed_dirs = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = atol(argv[++i]);
+        else if (strcmp(argv[i], "--max-len") == 0 && i + 1 < argc) max_len = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) g_rng = strtoull(argv[++i], NULL, 0) | 1;
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) out_dir = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            cost_init();
+            for_each_file(argv[++i], replay_file, NULL);
+            return 0;
+        }
+        else if (argv[i][0] != '-' && n_seed_dirs < 16) seed_dirs[n_seed_dirs++] = argv[i];
+        else {
+            fprintf(stderr, "usage: %s [--seconds S] [--runs N] [--max-len B] [--seed X] [--out DIR] [SEED_DIR...]\n"
+                            "       %s --replay DIR\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (max_len < 64) max_len = 64;
+    cost_init();
+
+    InputSet corpus = {0};
+    for (size_t i = 0; i < sizeof SEEDS / sizeof *SEEDS; ++i) {
+        size_t len = strlen(SEEDS[i]);
+        add_seed_file(NULL, SEEDS[i], len, &corpus);
+    }
+    for (int i = 0; i < n_seed_dirs; ++i) for_each_file(seed_dirs[i], add_seed_file, &corpus);
+    for (size_t i = 0; i < corpus.n; ++i) worst_offer(corpus.v[i].data, corpus.v[i].len, corpus.v[i].score);
+    fprintf(stderr, "fuzz_verify: %zu seeds, cost in %s, coverage %s\n", corpus.n, cost_unit(),
+            g_cov_enabled ? "on" : "off (checker not built with -fsanitize-coverage=trace-pc)");
+
+    char *buf = malloc(max_len + 1);
+    if (!buf) { perror("malloc"); return 1; }
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    double best = 0;
+    for (long it = 0; runs < 0 || it < runs; ++it) {
+        if ((it & 255) == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            double el = (double)(now.tv_sec - start.tv_sec) + (double)(now.tv_nsec - start.tv_nsec) / 1e9;
+            if (runs < 0 && el >= seconds) break;
+            if ((it & 32767) == 0)
+                fprintf(stderr, "#%ld %.0fs corpus %zu worst %.1f %s/byte\n", it, el, corpus.n, best, cost_unit());
+        }
+        /* pick the better of two random entries: biased toward slow inputs */
+        const Input *a = &corpus.v[rnd_below(corpus.n)], *b = &corpus.v[rnd_below(corpus.n)];
+        const Input *parent = a->score >= b->score ? a : b;
+        size_t len = parent->len < max_len ? parent->len : max_len;
+        memcpy(buf, parent->data, len);
+        for (int k = 1 + (int)rnd_below(4); k > 0; --k) len = mutate(buf, len, max_len, &corpus);
+
+        double score = cost_score(run_input(buf, len), len);
+        int fresh = cov_merge_new();
+        if (score > parent->score * 1.5 || score > worst_floor())
+            score = cost_score(measure(buf, len, 3), len);   // confirm before keeping
+        int slow = worst_offer(buf, len, score);
+        if (fresh || slow || score > parent->score * 1.5) set_add(&corpus, buf, len, score);
+        if (slow && score > best) {
+            best = score;
+            worst_save(out_dir);
+        }
+    }
+    worst_save(out_dir);
+    fprintf(stderr, "fuzz_verify: done, corpus %zu, worst %.1f %s/byte, saved %d inputs to %s/\n",
+            corpus.n, best, cost_unit(), g_worst_n, out_dir);
+    free(buf);
+    return 0;
+}
+
+#endif /* PC_LIBFUZZER */
@@ -3,14 +3,274 @@
 //  gcc -std=c11 -O2 -Wall -fPIC -c proof_checker.c -o proof_checker.o
 //  gcc -shared -o libproofchecker.so proof_checker.o
 //
+// (on glibc older than 2.34 add -lrt -pthread for shm_open and the
+// portfolio prover's threads)
+//
 // Optional standalone build:
-//  gcc -std=c11 -O2 -Wall -DBUILD_STANDALONE -o proof_checker proof_checker.c
+//  gcc -std=c11 -O2 -Wall -pthread -DBUILD_STANDALONE -o proof_checker proof_checker.c
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+
+#include "proof_checker.h"
+
+/* Static probes for bpftrace / perf / SystemTap (provider "proof_checker"):
+     verify__entry(len)          a verify_proof* call starts, input bytes
+     verify__return(rc, lines)   it returns
+     line__checked(line, rule, ok)  one proof line was checked (rule: Rule enum)
+     parse__fail(line, rc)       reading or parsing failed (line 0: not line-specific)
+     store__full(count, capacity)   the formula store refused an insertion
+   Each probe is a single nop with its arguments described in an ELF note,
+   so there is nothing to pay until a tracer attaches. Built without
+   <sys/sdt.h> (or with -DPC_NO_PROBES) the probes compile away. */
+#if !defined(PC_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PC_PROBE1(name, a) STAP_PROBE1(proof_checker, name, a)
+#define PC_PROBE2(name, a, b) STAP_PROBE2(proof_checker, name, a, b)
+#define PC_PROBE3(name, a, b, c) STAP_PROBE3(proof_checker, name, a, b, c)
+#endif
+#endif
+#ifndef PC_PROBE1
+/* sizeof keeps the arguments "used" without evaluating them */
+#define PC_PROBE1(name, a) ((void)sizeof(a))
+#define PC_PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#define PC_PROBE3(name, a, b, c) ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c))
+#endif
+
+/* ---------------- Allocation profile (-DPC_ALLOC_PROFILE) ---------------- */
+
+/* In a profiling build every malloc/calloc/realloc/strdup/strndup/free in
+   this file goes through the wrappers below. Each call site (function and
+   line) gets a slot the first time it runs; a slot counts allocations,
+   bytes and frees, and the most bytes it had live at once during a single
+   verify call. A free is charged to the site that allocated the pointer,
+   found in a per-thread table of live pointers, so no header is added to
+   the blocks and buffers handed to callers are still plain libc memory.
+   Only allocations made inside a verify call (between alloc_call_begin and
+   alloc_call_end) are counted, so the standalone program's own buffers and
+   the metrics printing stay out of the profile.  Pointers freed by another
+   thread (or by the caller) are not seen. */
+#ifdef PC_ALLOC_PROFILE
+#define ALLOC_SITES_MAX 256
+
+typedef struct {
+    const char *func;     // NULL until the slot is claimed
+    int line;
+    _Atomic uint64_t allocs, bytes, frees;
+    _Atomic uint64_t peak;
+} AllocSite;
+
+static AllocSite g_alloc_sites[ALLOC_SITES_MAX];
+static _Atomic int g_alloc_nsites = 0;
+static _Atomic uint64_t g_alloc_calls = 0;
+
+typedef struct {
+    uintptr_t p;          // address of a live block (0: empty slot)
+    size_t size;
+    int site;
+} LiveAlloc;
+
+static _Thread_local LiveAlloc *t_live = NULL;
+static _Thread_local size_t t_live_cap = 0, t_live_n = 0;
+static _Thread_local int64_t t_site_live[ALLOC_SITES_MAX];
+static _Thread_local int64_t t_site_peak[ALLOC_SITES_MAX];
+static _Thread_local int t_alloc_depth = 0;
+
+/* Slot of a call site; *id is the site's static cache (0: not yet assigned). */
+static int alloc_site(_Atomic int *id, const char *func, int line) {
+    int s = atomic_load_explicit(id, memory_order_acquire);
+    if (s) return s - 1;
+    s = atomic_fetch_add(&g_alloc_nsites, 1);
+    if (s >= ALLOC_SITES_MAX) return ALLOC_SITES_MAX - 1;   // overflow: charge the last slot
+    g_alloc_sites[s].line = line;
+    g_alloc_sites[s].func = func;
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(id, &expected, s + 1)) {
+        g_alloc_sites[s].func = NULL;                       // lost the race, slot stays unused
+        return expected - 1;
+    }
+    return s;
+}
+
+/* Free a thread's table when it exits. */
+static pthread_key_t g_live_key;
+static pthread_once_t g_live_once = PTHREAD_ONCE_INIT;
+
+static void live_table_free(void *tab) {
+    free(tab);
+    t_live = NULL;
+    t_live_cap = t_live_n = 0;
+}
+
+static void live_key_init(void) {
+    pthread_key_create(&g_live_key, live_table_free);
+}
+
+static size_t live_hash(uintptr_t p, size_t cap) {
+    uint64_t h = (uint64_t)p * 0x9E3779B97F4A7C15ull;
+    return (size_t)(h >> 20) & (cap - 1);
+}
+
+static void live_forget(int site, size_t size) {
+    t_site_live[site] -= (int64_t)size;
+    atomic_fetch_add_explicit(&g_alloc_sites[site].frees, 1, memory_order_relaxed);
+}
+
+static void live_add(uintptr_t p, size_t size, int site) {
+    if (2 * (t_live_n + 1) > t_live_cap) {
+        size_t ncap = t_live_cap ? 2 * t_live_cap : 1024;
+        LiveAlloc *nt = calloc(ncap, sizeof(LiveAlloc));
+        if (!nt) return;
+        for (size_t k = 0; k < t_live_cap; ++k) {
+            if (!t_live[k].p) continue;
+            size_t pos = live_hash(t_live[k].p, ncap);
+            while (nt[pos].p) pos = (pos + 1) & (ncap - 1);
+            nt[pos] = t_live[k];
+        }
+        if (!t_live) pthread_once(&g_live_once, live_key_init);
+        free(t_live);
+        t_live = nt;
+        t_live_cap = ncap;
+        pthread_setspecific(g_live_key, nt);
+    }
+    size_t pos = live_hash(p, t_live_cap);
+    while (t_live[pos].p && t_live[pos].p != p) pos = (pos + 1) & (t_live_cap - 1);
+    if (t_live[pos].p) live_forget(t_live[pos].site, t_live[pos].size);   // freed behind our back
+    else t_live_n++;
+    t_live[pos] = (LiveAlloc){ p, size, site };
+    t_site_live[site] += (int64_t)size;
+    if (t_site_live[site] > t_site_peak[site]) t_site_peak[site] = t_site_live[site];
+}
+
+/* Drop p from the table (backward-shift deletion keeps probes short). */
+static void live_remove(uintptr_t p) {
+    if (!p || !t_live_cap) return;
+    size_t mask = t_live_cap - 1, pos = live_hash(p, t_live_cap);
+    while (t_live[pos].p != p) {
+        if (!t_live[pos].p) return;                         // not ours
+        pos = (pos + 1) & mask;
+    }
+    live_forget(t_live[pos].site, t_live[pos].size);
+    t_live_n--;
+    for (size_t next = (pos + 1) & mask; t_live[next].p; next = (next + 1) & mask) {
+        size_t home = live_hash(t_live[next].p, t_live_cap);
+        /* move the entry back if its home is not between the hole and it */
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            t_live[pos] = t_live[next];
+            pos = next;
+        }
+    }
+    t_live[pos].p = 0;
+}
+
+static void *alloc_note(void *p, size_t size, int site) {
+    if (!p || !t_alloc_depth) return p;
+    atomic_fetch_add_explicit(&g_alloc_sites[site].allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_alloc_sites[site].bytes, size, memory_order_relaxed);
+    live_add((uintptr_t)p, size, site);
+    return p;
+}
+
+static void *prof_malloc(size_t n, int site) { return alloc_note(malloc(n), n, site); }
+static void *prof_calloc(size_t n, size_t m, int site) { return alloc_note(calloc(n, m), n * m, site); }
+static char *prof_strdup(const char *s, int site) { return alloc_note(strdup(s), strlen(s) + 1, site); }
+static char *prof_strndup(const char *s, size_t n, int site) {
+    char *d = strndup(s, n);
+    return alloc_note(d, d ? strlen(d) + 1 : 0, site);
+}
+static void prof_free(void *p) {
+    live_remove((uintptr_t)p);
+    free(p);
+}
+static void *prof_realloc(void *p, size_t n, int site) {
+    uintptr_t old = (uintptr_t)p;
+    void *q = realloc(p, n);
+    if (!q) return NULL;
+    live_remove(old);
+    return alloc_note(q, n, site);
+}
+
+/* Per-verification peaks: a verify call starts its sites at zero live bytes
+   and folds the highest level each reached into the global peaks. */
+static void alloc_call_begin(void) {
+    if (t_alloc_depth++) return;
+    int n = atomic_load(&g_alloc_nsites);
+    if (n > ALLOC_SITES_MAX) n = ALLOC_SITES_MAX;
+    memset(t_site_live, 0, (size_t)n * sizeof(int64_t));
+    memset(t_site_peak, 0, (size_t)n * sizeof(int64_t));
+}
+
+static void alloc_call_end(void) {
+    if (--t_alloc_depth) return;
+    atomic_fetch_add_explicit(&g_alloc_calls, 1, memory_order_relaxed);
+    int n = atomic_load(&g_alloc_nsites);
+    if (n > ALLOC_SITES_MAX) n = ALLOC_SITES_MAX;
+    for (int s = 0; s < n; ++s) {
+        uint64_t v = (uint64_t)t_site_peak[s];
+        uint64_t m = atomic_load_explicit(&g_alloc_sites[s].peak, memory_order_relaxed);
+        while (t_site_peak[s] > 0 && v > m &&
+               !atomic_compare_exchange_weak_explicit(&g_alloc_sites[s].peak, &m, v,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            ;
+    }
+}
+
+int pc_alloc_stats(pc_alloc_site *out, int max, unsigned long long *calls, int reset) {
+    if (calls) *calls = reset ? atomic_exchange(&g_alloc_calls, 0) : atomic_load(&g_alloc_calls);
+    int n = atomic_load(&g_alloc_nsites), filled = 0;
+    if (n > ALLOC_SITES_MAX) n = ALLOC_SITES_MAX;
+    for (int s = 0; s < n; ++s) {
+        AllocSite *a = &g_alloc_sites[s];
+        if (!a->func) continue;
+        pc_alloc_site v = {
+            a->func, a->line,
+            reset ? atomic_exchange(&a->allocs, 0) : atomic_load(&a->allocs),
+            reset ? atomic_exchange(&a->bytes, 0) : atomic_load(&a->bytes),
+            reset ? atomic_exchange(&a->frees, 0) : atomic_load(&a->frees),
+            reset ? atomic_exchange(&a->peak, 0) : atomic_load(&a->peak),
+        };
+        if (!v.allocs) continue;    // ran only outside verify calls, or not since the reset
+        if (out && filled < max) out[filled] = v;
+        filled++;
+    }
+    return filled;
+}
+
+/* From here on the allocation functions are the profiling wrappers. */
+#define ALLOC_SITE() __extension__ ({ static _Atomic int site_; alloc_site(&site_, __func__, __LINE__); })
+#undef strdup
+#undef strndup
+#define malloc(n) prof_malloc((n), ALLOC_SITE())
+#define calloc(n, m) prof_calloc((n), (m), ALLOC_SITE())
+#define realloc(p, n) prof_realloc((p), (n), ALLOC_SITE())
+#define strdup(s) prof_strdup((s), ALLOC_SITE())
+#define strndup(s, n) prof_strndup((s), (n), ALLOC_SITE())
+#define free(p) prof_free(p)
+
+#else
+#define alloc_call_begin() ((void)0)
+#define alloc_call_end() ((void)0)
+
+int pc_alloc_stats(pc_alloc_site *out, int max, unsigned long long *calls, int reset) {
+    (void)out; (void)max; (void)reset;
+    if (calls) *calls = 0;
+    return -1;
+}
+#endif /* PC_ALLOC_PROFILE */
 
 /* Simple AST for WFFs in prefix notation.
    Nodes:
@@ -21,23 +281,67 @@
 typedef struct Node {
     char kind;
     char atom;            // valid if kind == 'A'
+    uint32_t id;          // formula store id (0 if not interned)
     struct Node *left;
     struct Node *right;
 } Node;
 
+/* Justification rules. The text form is classified once per line; binary
+   proofs carry the rule and its operands directly. */
+typedef enum {
+    RULE_UNPARSED = 0,
+    RULE_PREMISE,
+    RULE_AX1,
+    RULE_AX2,
+    RULE_AX3,
+    RULE_MP,
+    RULE_SUBST,
+    RULE_LEMMA,
+    RULE_BAD_MP,          // "MP" without two line numbers
+    RULE_BAD_SUBST,       // "Substitution" without a usable X=<wff>
+    RULE_UNKNOWN,
+    RULE_COUNT
+} Rule;
+
+/* Small formulas are packed into one machine word, 5 bits per symbol with
+   the first symbol in the top bits (c = 1, n = 2, A..Z = 3..28; 0 pads the
+   rest). A formula of up to PACK_MAX symbols then needs no Node at all: two
+   packed formulas are equal iff their words are, and a subformula is a
+   shift and a mask. */
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 PackWord;
+#define PACK_MAX 25
+#else
+typedef uint64_t PackWord;
+#define PACK_MAX 12
+#endif
+#define PACK_BITS ((int)sizeof(PackWord) * 8)
+
+typedef struct {
+    PackWord bits;
+    int len;              // symbols; 0 if the formula is not packed
+} Packed;
+
 /* Proof line representation */
 typedef struct {
     int line_no;
     char *formula_str;    // original string (whitespace removed)
-    Node *formula_ast;    // parsed AST (NULL until parsed)
+    Node *formula_ast;    // parsed AST (NULL until parsed, or until needed for a packed line)
+    Packed packed;        // small formula, when no formula store is attached
     char *just;           // justification string
+    Rule rule;            // classified justification (RULE_UNPARSED until checked)
+    int arg1, arg2;       // MP line numbers
+    char subst_var;       // Substitution variable
+    Node *subst_ast;      // Substitution replacement
 } ProofLine;
 
-/* Dynamic storage for proof lines */
+/* Dynamic storage for proof lines.
+   Per-call state is thread-local, so verify_proof may run on several threads
+   at once (sharing only the formula store). */
 #define INITIAL_CAP 256
-static ProofLine *proof = NULL;
-static int proof_capacity = 0;
-static int proof_count = 0;
+static _Thread_local ProofLine *proof = NULL;
+static _Thread_local int proof_capacity = 0;
+static _Thread_local int proof_count = 0;
 
 /* Utility: allocate or expand proof array */
 static void ensure_proof_capacity(void) {
@@ -102,9 +406,29 @@ static int sb_appendf(StrBuf *s, const char *fmt, ...) {
     return 1;
 }
 
+/* Store generation of the running verify_proof call (0 outside a call:
+   nothing may be interned then, since a sweep could run concurrently) */
+static _Thread_local uint32_t g_gen = 0;
+
 /* Global output buffer pointer used by internal functions */
-static StrBuf g_sb;
-static StrBuf *g_out = NULL;
+static _Thread_local StrBuf g_sb;
+static _Thread_local StrBuf *g_out = NULL;
+
+/* Streaming (verify_proof_stream): results go to a callback as they are
+   produced, and g_out only holds the messages of the line being checked. */
+static _Thread_local struct {
+    pc_line_callback cb;
+    void *ctx;
+    int in_line;          // inside check_line: messages wait for the verdict
+    int stopped;          // the callback asked to stop
+} g_stream;
+
+static void stream_message(void);
+
+/* Report limits (pc_report_limits); 0 means unlimited. */
+static _Atomic size_t g_max_text = 0;
+static _Atomic size_t g_max_report = 0;
+static _Thread_local size_t t_omitted = 0;   // messages dropped by the report cap in this call
 
 /* Helper to append messages to global output buffer */
 static void out_append(const char *fmt, ...) {
@@ -114,12 +438,323 @@ static void out_append(const char *fmt, ...) {
     int needed = vsnprintf(NULL, 0, fmt, ap);
     va_end(ap);
     if (needed < 0) return;
+    size_t cap = atomic_load_explicit(&g_max_report, memory_order_relaxed);
+    if (cap && g_out->len + (size_t)needed > cap) {
+        t_omitted++;
+        return;
+    }
     size_t want = (size_t)needed + 1 + g_out->len;
     if (!sb_grow_to(g_out, want)) return;
     va_start(ap, fmt);
     vsnprintf(g_out->buf + g_out->len, g_out->cap - g_out->len, fmt, ap);
     va_end(ap);
     g_out->len += (size_t)needed;
+    if (g_stream.cb && !g_stream.in_line) stream_message();
+}
+
+void pc_report_limits(size_t max_text, size_t max_report) {
+    atomic_store(&g_max_text, max_text);
+    atomic_store(&g_max_report, max_report);
+}
+
+/* Scratch space for elided texts; slot 0 and 1 so one message can show two. */
+static _Thread_local StrBuf t_shown[2];
+
+/* s as the report shows it: itself, or, if longer than the text limit, its
+   first and last max_text/2 bytes around its length and FNV-1a hash, so
+   equal long formulas can still be recognised. Texts the marker would not
+   shorten are shown whole. */
+static const char *shown(const char *s, int slot) {
+    size_t max = atomic_load_explicit(&g_max_text, memory_order_relaxed);
+    if (!s || !max) return s;
+    size_t n = strlen(s);
+    if (n <= max) return s;
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t k = 0; k < n; ++k) h = (h ^ (unsigned char)s[k]) * 0x100000001b3ull;
+    int half = max / 2 > 0 ? (int)(max / 2) : 1;
+    StrBuf *sb = &t_shown[slot];
+    if (!sb->buf && !sb_init(sb)) return "...";
+    sb->len = 0;
+    if (!sb_appendf(sb, "%.*s...[%zu bytes #%016llx]...%s", half, s, n, (unsigned long long)h, s + n - half))
+        return "...";
+    return sb->len < n ? sb->buf : s;
+}
+
+/* ---------------- Trace events ---------------- */
+
+/* Optional span tracing (pc_trace_start / pc_trace_stop). Every thread that
+   verifies while tracing is on gets its own fixed-size event buffer, which
+   only that thread appends to; the buffer is pushed onto a global list with
+   a CAS when it is created, so recording a span takes no lock. When tracing
+   is off the cost is one relaxed atomic load per span. */
+
+typedef struct {
+    const char *name;     // static string
+    uint64_t ts, dur;     // ns, CLOCK_MONOTONIC
+    const char *arg_name; // static string or NULL
+    long arg;
+    char *proof;          // proof id (malloc'd), "verify" spans only
+} TraceEvent;
+
+typedef struct TraceBuf {
+    struct TraceBuf *next;
+    unsigned epoch;
+    long tid;
+    _Atomic uint32_t count;
+    _Atomic uint32_t dropped;
+    uint32_t cap;
+    TraceEvent ev[];
+} TraceBuf;
+
+static _Atomic int g_trace_on = 0;
+static _Atomic unsigned g_trace_epoch = 0;
+static uint32_t g_trace_cap = 0;
+static TraceBuf *_Atomic g_trace_bufs = NULL;
+
+static _Thread_local TraceBuf *t_trace = NULL;
+static _Thread_local unsigned t_trace_epoch = 0;
+static _Thread_local char *t_trace_id = NULL;
+static _Thread_local int t_call_lines = 0;    // lines of the call being finished
+
+static uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Start time of a span, or 0 when tracing is off. */
+static uint64_t trace_begin(void) {
+    return atomic_load_explicit(&g_trace_on, memory_order_relaxed) ? trace_now() : 0;
+}
+
+static _Atomic int g_metrics_on = 0;
+
+/* Like trace_begin, for spans that also feed the latency histograms. */
+static uint64_t span_begin(void) {
+    return atomic_load_explicit(&g_trace_on, memory_order_relaxed)
+        || atomic_load_explicit(&g_metrics_on, memory_order_relaxed) ? trace_now() : 0;
+}
+
+static TraceBuf *trace_buf(void) {
+    unsigned epoch = atomic_load_explicit(&g_trace_epoch, memory_order_acquire);
+    if (t_trace && t_trace_epoch == epoch) return t_trace;
+    /* first span of this thread in this tracing session */
+    TraceBuf *b = (TraceBuf*)malloc(sizeof(TraceBuf) + (size_t)g_trace_cap * sizeof(TraceEvent));
+    t_trace = b;
+    t_trace_epoch = epoch;
+    if (!b) return NULL;
+    b->epoch = epoch;
+    b->tid = (long)syscall(SYS_gettid);
+    atomic_init(&b->count, 0);
+    atomic_init(&b->dropped, 0);
+    b->cap = g_trace_cap;
+    TraceBuf *head = atomic_load_explicit(&g_trace_bufs, memory_order_relaxed);
+    do {
+        b->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&g_trace_bufs, &head, b,
+                                                    memory_order_release, memory_order_relaxed));
+    return b;
+}
+
+/* Record a span that started at t0 (a trace_begin or span_begin result).
+   Returns its duration in ns (0 if t0 is 0). */
+static uint64_t trace_end(const char *name, uint64_t t0, const char *arg_name, long arg) {
+    if (!t0) return 0;
+    uint64_t now = trace_now();
+    if (!atomic_load_explicit(&g_trace_on, memory_order_relaxed)) return now - t0;
+    TraceBuf *b = trace_buf();
+    if (!b) return now - t0;
+    uint32_t n = atomic_load_explicit(&b->count, memory_order_relaxed);
+    if (n >= b->cap) {
+        atomic_fetch_add_explicit(&b->dropped, 1, memory_order_relaxed);
+        return now - t0;
+    }
+    TraceEvent *e = &b->ev[n];
+    e->name = name;
+    e->ts = t0;
+    e->dur = now - t0;
+    e->arg_name = arg_name;
+    e->arg = arg;
+    e->proof = NULL;
+    if (strcmp(name, "verify") == 0 && t_trace_id) e->proof = strdup(t_trace_id);
+    atomic_store_explicit(&b->count, n + 1, memory_order_release);
+    return now - t0;
+}
+
+static const char *RULE_SPAN[RULE_COUNT] = {
+    "check ?", "check Premise", "check AX1", "check AX2", "check AX3", "check MP",
+    "check Substitution", "check Lemma", "check bad MP", "check bad Substitution", "check unknown",
+};
+
+int pc_trace_start(size_t events_per_thread) {
+    if (events_per_thread == 0 || events_per_thread > UINT32_MAX) return -1;
+    if (atomic_load(&g_trace_on)) return -2;
+    g_trace_cap = (uint32_t)events_per_thread;
+    atomic_fetch_add(&g_trace_epoch, 1);
+    atomic_store(&g_trace_on, 1);
+    return 0;
+}
+
+void pc_trace_set_id(const char *proof_id) {
+    free(t_trace_id);
+    t_trace_id = proof_id ? strdup(proof_id) : NULL;
+}
+
+static void trace_write_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; ++s) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') fprintf(f, "\\%c", ch);
+        else if (ch < 0x20) fprintf(f, "\\u%04x", ch);
+        else fputc(ch, f);
+    }
+    fputc('"', f);
+}
+
+int pc_trace_stop(const char *path) {
+    if (!atomic_exchange(&g_trace_on, 0)) return -1;
+    TraceBuf *bufs = atomic_exchange(&g_trace_bufs, NULL);
+    FILE *f = path ? fopen(path, "w") : NULL;
+    int rc = path && !f ? -2 : 0;
+    if (f) {
+        long pid = (long)getpid();
+        unsigned long dropped = 0;
+        const char *sep = "";
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for (TraceBuf *b = bufs; b; b = b->next) {
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,"
+                       "\"args\":{\"name\":\"verifier %ld\"}}", sep, pid, b->tid, b->tid);
+            sep = ",\n";
+            uint32_t n = atomic_load_explicit(&b->count, memory_order_acquire);
+            dropped += atomic_load(&b->dropped);
+            for (uint32_t k = 0; k < n; ++k) {
+                const TraceEvent *e = &b->ev[k];
+                fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"pc\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                           "\"pid\":%ld,\"tid\":%ld,\"args\":{",
+                        e->name, (double)e->ts / 1e3, (double)e->dur / 1e3, pid, b->tid);
+                const char *asep = "";
+                if (e->proof) { fprintf(f, "\"proof\":"); trace_write_string(f, e->proof); asep = ","; }
+                if (e->arg_name) fprintf(f, "%s\"%s\":%ld", asep, e->arg_name, e->arg);
+                fprintf(f, "}}");
+            }
+        }
+        fprintf(f, "\n],\"otherData\":{\"dropped_events\":%lu}}\n", dropped);
+        if (fclose(f) != 0) rc = -2;
+    }
+    while (bufs) {
+        TraceBuf *next = bufs->next;
+        uint32_t n = atomic_load(&bufs->count);
+        for (uint32_t k = 0; k < n; ++k) free(bufs->ev[k].proof);
+        free(bufs);
+        bufs = next;
+    }
+    return rc;
+}
+
+/* ---------------- Metrics ---------------- */
+
+/* Histograms are plain arrays of atomic counters shared by all threads:
+   recording is a relaxed fetch_add on one bucket plus the running sum, and
+   the max is raised with a CAS only when it grows. */
+typedef struct {
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[PC_HIST_BUCKETS];
+} Histogram;
+
+static Histogram g_hist[PC_HIST_COUNT];
+static _Atomic uint64_t g_rc_count[PC_RC_SLOTS];
+
+/* Values below 16 get a bucket each; above that, 16 buckets per power of two. */
+static int hist_bucket(uint64_t v) {
+    if (v < 16) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    return 16 + (e - 4) * 16 + (int)((v >> (e - 4)) & 15);
+}
+
+uint64_t pc_hist_bucket_max(int b) {
+    if (b < 16) return b < 0 ? 0 : (uint64_t)b;
+    if (b >= PC_HIST_BUCKETS) return UINT64_MAX;
+    int e = (b - 16) / 16 + 4, sub = (b - 16) % 16;
+    uint64_t lo = (uint64_t)(16 + sub) << (e - 4);
+    return lo + ((uint64_t)1 << (e - 4)) - 1;
+}
+
+static void hist_record(int which, uint64_t v) {
+    Histogram *h = &g_hist[which];
+    atomic_fetch_add_explicit(&h->buckets[hist_bucket(v)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, v, memory_order_relaxed);
+    uint64_t m = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (v > m && !atomic_compare_exchange_weak_explicit(&h->max, &m, v,
+                                                           memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/* An observer of run_verify's phases for bench_phases, which samples
+   hardware counters around them.  It is called on entering (end == 0) and
+   leaving (end == 1) the tokenize, parse and check phases (PC_HIST_*_NS)
+   with line -1, and around each line of the parse and check phases with
+   the line's index.  Unset, it costs a thread-local load per line. */
+typedef void (*PhaseHook)(void *ctx, int phase, int line, int end);
+static _Thread_local PhaseHook g_phase_hook = NULL;
+static _Thread_local void *g_phase_ctx = NULL;
+
+#define PHASE_HOOK(phase, line, end) \
+    do { if (g_phase_hook) g_phase_hook(g_phase_ctx, (phase), (line), (end)); } while (0)
+
+/* Record a phase that started at t0 (a span_begin result). */
+static void phase_end(int which, const char *name, uint64_t t0, const char *arg_name, long arg) {
+    uint64_t dur = trace_end(name, t0, arg_name, arg);
+    if (t0 && atomic_load_explicit(&g_metrics_on, memory_order_relaxed)) hist_record(which, dur);
+}
+
+/* Account a finished verify call: latency, size and return code. */
+static void metrics_call(uint64_t t0, uint64_t dur, size_t len, int lines, int rc) {
+    if (!t0 || !atomic_load_explicit(&g_metrics_on, memory_order_relaxed)) return;
+    hist_record(PC_HIST_VERIFY_NS, dur);
+    hist_record(PC_HIST_PROOF_BYTES, len);
+    hist_record(PC_HIST_PROOF_LINES, (uint64_t)lines);
+    atomic_fetch_add_explicit(&g_rc_count[PC_RC_SLOT(rc)], 1, memory_order_relaxed);
+}
+
+void pc_metrics_enable(int on) {
+    atomic_store(&g_metrics_on, on != 0);
+}
+
+static uint64_t take(_Atomic uint64_t *c, int reset) {
+    return reset ? atomic_exchange_explicit(c, 0, memory_order_relaxed)
+                 : atomic_load_explicit(c, memory_order_relaxed);
+}
+
+void pc_metrics_snapshot(pc_metrics *out, int reset) {
+    if (!out) return;
+    for (int k = 0; k < PC_HIST_COUNT; ++k) {
+        Histogram *h = &g_hist[k];
+        pc_histogram *o = &out->hist[k];
+        o->count = 0;
+        for (int b = 0; b < PC_HIST_BUCKETS; ++b) {
+            o->buckets[b] = take(&h->buckets[b], reset);
+            o->count += o->buckets[b];
+        }
+        o->sum = take(&h->sum, reset);
+        o->max = take(&h->max, reset);
+    }
+    for (int k = 0; k < PC_RC_SLOTS; ++k) out->rc[k] = take(&g_rc_count[k], reset);
+}
+
+uint64_t pc_hist_quantile(const pc_histogram *h, double q) {
+    if (!h || h->count == 0) return 0;
+    if (q < 0) q = 0;
+    if (q > 1) q = 1;
+    uint64_t rank = (uint64_t)(q * (double)(h->count - 1)) + 1, seen = 0;
+    for (int b = 0; b < PC_HIST_BUCKETS; ++b) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            uint64_t v = pc_hist_bucket_max(b);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
 }
 
 /* ---------------- Forward declarations (parsing etc.) ---------------- */
@@ -129,13 +764,13 @@ static void free_tree(Node *n);
 static Node *clone_tree(const Node *n);
 static int equal_tree(const Node *a, const Node *b);
 static void skip_ws_str(const char *s, int *idx);
+static Node *line_ast(int k);
 
 /* ---------------- Parsing functions ---------------- */
 
 /* skip whitespace in a string, advancing idx */
 static void skip_ws_str(const char *s, int *idx) {
-    int n = (int)strlen(s);
-    while (*idx < n && isspace((unsigned char)s[*idx])) (*idx)++;
+    while (s[*idx] && isspace((unsigned char)s[*idx])) (*idx)++;
 }
 
 /* Parse a WFF starting at s[idx] (no leading whitespace assumed).
@@ -144,15 +779,15 @@ static void skip_ws_str(const char *s, int *idx) {
 */
 static Node *parse_node(const char *s, int *idx) {
     skip_ws_str(s, idx);
-    int n = (int)strlen(s);
-    if (*idx >= n) return NULL;
     char tok = s[*idx];
+    if (tok == '\0') return NULL;
 
     if (isupper((unsigned char)tok)) {
         Node *node = (Node*)malloc(sizeof(Node));
         if (!node) { perror("malloc"); exit(EXIT_FAILURE); }
         node->kind = 'A';
         node->atom = tok;
+        node->id = 0;
         node->left = node->right = NULL;
         (*idx)++;
         return node;
@@ -165,6 +800,7 @@ static Node *parse_node(const char *s, int *idx) {
         if (!node) { perror("malloc"); exit(EXIT_FAILURE); }
         node->kind = 'N';
         node->atom = 0;
+        node->id = 0;
         node->left = child;
         node->right = NULL;
         return node;
@@ -179,6 +815,7 @@ static Node *parse_node(const char *s, int *idx) {
         if (!node) { perror("malloc"); exit(EXIT_FAILURE); }
         node->kind = 'C';
         node->atom = 0;
+        node->id = 0;
         node->left = left;
         node->right = right;
         return node;
@@ -215,15 +852,37 @@ static Node *clone_tree(const Node *n) {
     if (!c) { perror("malloc"); exit(EXIT_FAILURE); }
     c->kind = n->kind;
     c->atom = n->atom;
+    c->id = n->id;
     c->left = clone_tree(n->left);
     c->right = clone_tree(n->right);
     return c;
 }
 
+/* Serialize an AST in prefix form into buf (which must be large enough). */
+static size_t tree_to_prefix(const Node *n, char *buf) {
+    if (n->kind == 'A') { buf[0] = n->atom; return 1; }
+    if (n->kind == 'N') { buf[0] = 'n'; return 1 + tree_to_prefix(n->left, buf + 1); }
+    buf[0] = 'c';
+    size_t l = tree_to_prefix(n->left, buf + 1);
+    return 1 + l + tree_to_prefix(n->right, buf + 1 + l);
+}
+
+static size_t tree_size(const Node *n) {
+    if (!n) return 0;
+    return 1 + tree_size(n->left) + tree_size(n->right);
+}
+
+/* Formula nodes visited by the checking kernels (equal_tree,
+   match_pattern_rec, subst_equal) in this thread; read by the profiler. */
+static _Thread_local unsigned long g_visits = 0;
+
 /* Structural equality of ASTs */
 static int equal_tree(const Node *a, const Node *b) {
+    g_visits++;
     if (a == NULL && b == NULL) return 1;
     if (a == NULL || b == NULL) return 0;
+    /* interned ids are canonical: equal ids <=> equal formulas */
+    if (a->id && b->id) return a->id == b->id;
     if (a->kind != b->kind) return 0;
     if (a->kind == 'A') return a->atom == b->atom;
     if (a->kind == 'N') return equal_tree(a->left, b->left);
@@ -231,6 +890,525 @@ static int equal_tree(const Node *a, const Node *b) {
     return 0;
 }
 
+/* ---------------- Interned formula store ---------------- */
+
+/* A formula store hash-conses formulas into small integer ids: a formula is
+   an entry (kind, atom, left id, right id), so two formulas are equal iff
+   their ids are equal.  The store is position independent (ids, no pointers)
+   and append-only, which lets it live in a shared-memory segment used by
+   several worker processes at once:
+     - entries are allocated with an atomic fetch-add on `count`;
+     - an entry is published by CAS-ing its id into an empty hash slot, so a
+       reader that finds an id in a slot always sees a fully written entry;
+     - slots are never cleared, so lookups need no locks.
+   Two processes racing to insert the same formula both allocate an entry but
+   only one wins the slot; the loser's entry is simply never referenced.
+   Entries flagged STORE_LEMMA are formulas some worker proved without
+   premises; they can be cited by any later proof with the "Lemma" rule.
+
+   A store private to the process (pc_store_create, or a restored snapshot)
+   is also reclaimable: each verify_proof call is a generation, entries
+   remember the last generation that used them, and once the store grows
+   past its high watermark it is swept down to the low watermark, keeping
+   lemmas and the most recently used formulas.  Ids are only held by Node
+   trees during a verify_proof call, so the sweep runs when no call is in
+   flight: the call that finds the store over its watermark marks a sweep
+   pending, new calls wait while one is pending, and the last call in flight
+   to leave runs it.  Calls never overlap a pending sweep indefinitely. */
+
+#define STORE_MAGIC   0x54534350u   /* "PCST" */
+#define STORE_VERSION 2u
+#define STORE_LEMMA   1u
+
+typedef struct {
+    uint8_t kind;
+    uint8_t atom;
+    uint16_t reserved;
+    _Atomic uint32_t flags;
+    uint32_t left;
+    uint32_t right;
+    _Atomic uint32_t gen;          // last generation that interned this entry
+} StoreEntry;
+
+typedef struct {
+    _Atomic uint32_t magic;        // written last by the creator
+    uint32_t version;
+    uint32_t capacity;             // number of entries (id 0 is unused)
+    uint32_t nslots;               // hash slots, power of two
+    _Atomic uint32_t count;        // next id to hand out
+    _Atomic uint32_t lemmas;       // number of entries flagged STORE_LEMMA
+    _Atomic uint32_t epoch;        // current generation
+    uint64_t size;                 // total mapped size in bytes
+} StoreHeader;
+
+typedef struct {
+    StoreHeader *hdr;
+    StoreEntry *entries;
+    _Atomic uint32_t *slots;
+    size_t map_size;
+    int reclaimable;               // private to this process
+    uint32_t high, low;            // sweep watermarks (0 = never sweep)
+    _Atomic int active;            // calls using ids, plus STORE_SWEEP
+} FormulaStore;
+
+/* Set in FormulaStore.active while a sweep is pending or running. */
+#define STORE_SWEEP (1 << 30)
+
+static FormulaStore g_store_obj;
+static FormulaStore *g_store = NULL;
+static pthread_mutex_t g_sweep_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_sweep_done = PTHREAD_COND_INITIALIZER;
+
+static size_t store_layout(uint32_t capacity, uint32_t nslots) {
+    return sizeof(StoreHeader) + (size_t)capacity * sizeof(StoreEntry)
+         + (size_t)nslots * sizeof(uint32_t);
+}
+
+static void store_bind(FormulaStore *st, void *base, size_t size, int reclaimable) {
+    st->hdr = (StoreHeader*)base;
+    st->entries = (StoreEntry*)(st->hdr + 1);
+    st->slots = (_Atomic uint32_t*)(st->entries + st->hdr->capacity);
+    st->map_size = size;
+    st->reclaimable = reclaimable;
+    st->high = st->low = 0;
+    if (reclaimable) {
+        st->high = st->hdr->capacity / 4 * 3;
+        st->low = st->hdr->capacity / 2;
+    }
+    atomic_store(&st->active, 0);
+}
+
+static void store_init_header(StoreHeader *h, uint32_t capacity, uint32_t nslots, size_t size) {
+    h->version = STORE_VERSION;
+    h->capacity = capacity;
+    h->nslots = nslots;
+    atomic_store(&h->count, 1);
+    atomic_store(&h->lemmas, 0);
+    atomic_store(&h->epoch, 1);
+    h->size = size;
+    atomic_store_explicit(&h->magic, STORE_MAGIC, memory_order_release);
+}
+
+static uint32_t store_hash(char kind, char atom, uint32_t l, uint32_t r) {
+    uint64_t h = ((uint64_t)(unsigned char)kind << 8) | (unsigned char)atom;
+    h ^= (uint64_t)l * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)r * 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return (uint32_t)h;
+}
+
+static int store_entry_is(const StoreEntry *e, char kind, char atom, uint32_t l, uint32_t r) {
+    return e->kind == (uint8_t)kind && e->atom == (uint8_t)atom && e->left == l && e->right == r;
+}
+
+/* Return the id of (kind, atom, l, r), inserting it if needed.
+   Returns 0 if the store is full. */
+static uint32_t store_intern(FormulaStore *st, char kind, char atom, uint32_t l, uint32_t r) {
+    StoreHeader *h = st->hdr;
+    uint32_t mask = h->nslots - 1;
+    uint32_t pos = store_hash(kind, atom, l, r) & mask;
+    uint32_t fresh = 0;
+    for (uint32_t probe = 0; probe <= mask; ++probe, pos = (pos + 1) & mask) {
+        uint32_t id = atomic_load_explicit(&st->slots[pos], memory_order_acquire);
+        if (id == 0) {
+            if (!fresh) {
+                if (atomic_load_explicit(&h->count, memory_order_relaxed) >= h->capacity) {
+                    PC_PROBE2(store__full, h->count, h->capacity);
+                    return 0;
+                }
+                fresh = atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+                if (fresh >= h->capacity) {
+                    PC_PROBE2(store__full, fresh, h->capacity);
+                    return 0;
+                }
+                StoreEntry *e = &st->entries[fresh];
+                e->kind = (uint8_t)kind;
+                e->atom = (uint8_t)atom;
+                e->left = l;
+                e->right = r;
+                atomic_store_explicit(&e->flags, 0, memory_order_relaxed);
+                atomic_store_explicit(&e->gen, 0, memory_order_relaxed);
+            }
+            if (atomic_compare_exchange_strong_explicit(&st->slots[pos], &id, fresh,
+                                                        memory_order_release, memory_order_acquire))
+                return fresh;
+            /* lost the race: `id` now holds the winner, fall through and compare */
+        }
+        if (store_entry_is(&st->entries[id], kind, atom, l, r)) return id;
+    }
+    return 0;
+}
+
+/* Id of (kind, atom, l, r) if it is already in the store, else 0.
+   Inserts nothing, so it may be used for formulas that are only candidates. */
+static uint32_t store_lookup(FormulaStore *st, char kind, char atom, uint32_t l, uint32_t r) {
+    uint32_t mask = st->hdr->nslots - 1;
+    uint32_t pos = store_hash(kind, atom, l, r) & mask;
+    for (uint32_t probe = 0; probe <= mask; ++probe, pos = (pos + 1) & mask) {
+        uint32_t id = atomic_load_explicit(&st->slots[pos], memory_order_acquire);
+        if (id == 0) return 0;
+        if (store_entry_is(&st->entries[id], kind, atom, l, r)) return id;
+    }
+    return 0;
+}
+
+/* Intern every subtree of n bottom-up, filling in the id fields and marking
+   the entries as used in generation `gen`.
+   Returns the id of n (0 if the store filled up on the way). */
+static uint32_t intern_tree(FormulaStore *st, Node *n, uint32_t gen) {
+    if (!n) return 0;
+    if (n->id) {
+        /* cloned from a tree interned earlier in this call */
+        atomic_store_explicit(&st->entries[n->id].gen, gen, memory_order_relaxed);
+        return n->id;
+    }
+    uint32_t l = 0, r = 0;
+    if (n->kind == 'N' || n->kind == 'C') {
+        l = intern_tree(st, n->left, gen);
+        if (!l) return 0;
+    }
+    if (n->kind == 'C') {
+        r = intern_tree(st, n->right, gen);
+        if (!r) return 0;
+    }
+    n->id = store_intern(st, n->kind, n->kind == 'A' ? n->atom : 0, l, r);
+    if (n->id) {
+        _Atomic uint32_t *g = &st->entries[n->id].gen;
+        if (atomic_load_explicit(g, memory_order_relaxed) != gen)
+            atomic_store_explicit(g, gen, memory_order_relaxed);
+    }
+    return n->id;
+}
+
+static int cmp_gen_desc(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* Keep the children of every kept entry. Children always have smaller ids
+   than their parents (they are interned first), so one descending pass
+   reaches the whole closure. */
+static uint32_t store_keep_closure(const StoreEntry *e, unsigned char *keep, uint32_t n) {
+    uint32_t kept = 0;
+    for (uint32_t id = n - 1; id >= 1; --id) {
+        if (!keep[id]) continue;
+        kept++;
+        if (e[id].left) keep[e[id].left] = 1;
+        if (e[id].right) keep[e[id].right] = 1;
+    }
+    return kept;
+}
+
+/* Compact the store down to lemmas plus the most recently used entries.
+   Caller must have exclusive access (active == STORE_SWEEP). */
+static void store_sweep(FormulaStore *st) {
+    StoreHeader *h = st->hdr;
+    StoreEntry *e = st->entries;
+    uint32_t n = atomic_load(&h->count);
+    if (n > h->capacity) n = h->capacity;
+    unsigned char *keep = (unsigned char*)calloc(n, 1);
+    uint32_t *gens = (uint32_t*)malloc(n * sizeof(uint32_t));
+    uint32_t *remap = (uint32_t*)malloc(n * sizeof(uint32_t));
+    if (!keep || !gens || !remap) { free(keep); free(gens); free(remap); return; }
+
+    /* 1. lemmas and everything they are built from */
+    for (uint32_t id = 1; id < n; ++id)
+        if (atomic_load_explicit(&e[id].flags, memory_order_relaxed) & STORE_LEMMA) keep[id] = 1;
+    uint32_t kept = store_keep_closure(e, keep, n);
+
+    /* 2. fill the remaining budget with whole generations, newest first */
+    uint32_t budget = st->low > kept ? st->low - kept : 0;
+    uint32_t m = 0;
+    for (uint32_t id = 1; id < n; ++id)
+        if (!keep[id]) gens[m++] = atomic_load_explicit(&e[id].gen, memory_order_relaxed);
+    if (budget > 0 && m > 0) {
+        uint32_t cutoff = 0;
+        if (m > budget) {
+            qsort(gens, m, sizeof(uint32_t), cmp_gen_desc);
+            cutoff = gens[budget] + 1;
+        }
+        for (uint32_t id = 1; id < n; ++id)
+            if (!keep[id] && atomic_load_explicit(&e[id].gen, memory_order_relaxed) >= cutoff) keep[id] = 1;
+        store_keep_closure(e, keep, n);
+    }
+
+    /* 3. slide kept entries down (ids stay ordered, so children still
+          precede parents) and rebuild the slot table */
+    uint32_t next = 1, lemmas = 0;
+    remap[0] = 0;
+    for (uint32_t id = 1; id < n; ++id) {
+        if (!keep[id]) { remap[id] = 0; continue; }
+        remap[id] = next;
+        StoreEntry *dst = &e[next];
+        uint32_t flags = atomic_load_explicit(&e[id].flags, memory_order_relaxed);
+        uint32_t gen = atomic_load_explicit(&e[id].gen, memory_order_relaxed);
+        dst->kind = e[id].kind;
+        dst->atom = e[id].atom;
+        dst->left = remap[e[id].left];
+        dst->right = remap[e[id].right];
+        atomic_store_explicit(&dst->flags, flags, memory_order_relaxed);
+        atomic_store_explicit(&dst->gen, gen, memory_order_relaxed);
+        if (flags & STORE_LEMMA) lemmas++;
+        next++;
+    }
+    memset((void*)st->slots, 0, (size_t)h->nslots * sizeof(uint32_t));
+    uint32_t mask = h->nslots - 1;
+    for (uint32_t id = 1; id < next; ++id) {
+        uint32_t pos = store_hash((char)e[id].kind, (char)e[id].atom, e[id].left, e[id].right) & mask;
+        while (atomic_load_explicit(&st->slots[pos], memory_order_relaxed)) pos = (pos + 1) & mask;
+        atomic_store_explicit(&st->slots[pos], id, memory_order_relaxed);
+    }
+    atomic_store(&h->lemmas, lemmas);
+    atomic_store(&h->count, next);
+    free(keep);
+    free(gens);
+    free(remap);
+}
+
+/* Bracket a verify_proof call that holds store ids. Returns the call's generation. */
+static uint32_t store_enter(FormulaStore *st) {
+    int v = atomic_load(&st->active);
+    for (;;) {
+        if (v & STORE_SWEEP) {
+            pthread_mutex_lock(&g_sweep_mu);
+            while (atomic_load(&st->active) & STORE_SWEEP) pthread_cond_wait(&g_sweep_done, &g_sweep_mu);
+            pthread_mutex_unlock(&g_sweep_mu);
+            v = atomic_load(&st->active);
+            continue;
+        }
+        if (atomic_compare_exchange_weak(&st->active, &v, v + 1)) break;
+    }
+    return atomic_fetch_add(&st->hdr->epoch, 1) + 1;
+}
+
+/* The flag is raised while this call still counts as active, so exactly one
+   call sees the count drop to zero with it set, and that call sweeps. */
+static void store_leave(FormulaStore *st) {
+    if (st->reclaimable && st->high && atomic_load(&st->hdr->count) > st->high)
+        atomic_fetch_or(&st->active, STORE_SWEEP);
+    if (atomic_fetch_sub(&st->active, 1) != (STORE_SWEEP | 1)) return;
+    store_sweep(st);
+    pthread_mutex_lock(&g_sweep_mu);
+    atomic_store(&st->active, 0);
+    pthread_cond_broadcast(&g_sweep_done);
+    pthread_mutex_unlock(&g_sweep_mu);
+}
+
+static int store_is_lemma(FormulaStore *st, uint32_t id) {
+    if (!st || !id) return 0;
+    return (atomic_load_explicit(&st->entries[id].flags, memory_order_acquire) & STORE_LEMMA) != 0;
+}
+
+static void store_add_lemma(FormulaStore *st, uint32_t id) {
+    if (!st || !id) return;
+    uint32_t old = atomic_fetch_or_explicit(&st->entries[id].flags, STORE_LEMMA, memory_order_release);
+    if (!(old & STORE_LEMMA)) atomic_fetch_add_explicit(&st->hdr->lemmas, 1, memory_order_relaxed);
+}
+
+int pc_store_attach_shared(const char *name, unsigned capacity) {
+    if (!name || g_store) return -1;
+    if (capacity < 2) capacity = PC_STORE_DEFAULT_CAPACITY;
+    uint32_t nslots = 1;
+    while (nslots < 2u * capacity) nslots <<= 1;
+    size_t size = store_layout(capacity, nslots);
+
+    int created = 1;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        created = 0;
+        fd = shm_open(name, O_RDWR, 0600);
+        if (fd < 0) return -2;
+    }
+    if (created) {
+        if (ftruncate(fd, (off_t)size) != 0) { close(fd); shm_unlink(name); return -3; }
+    } else {
+        /* another process created it: wait until it has been sized, then
+           use its geometry instead of ours */
+        struct stat sb;
+        for (int tries = 0; ; ++tries) {
+            if (fstat(fd, &sb) != 0) { close(fd); return -3; }
+            if (sb.st_size >= (off_t)sizeof(StoreHeader)) break;
+            if (tries > 1000) { close(fd); return -4; }
+            usleep(1000);
+        }
+        size = (size_t)sb.st_size;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -5;
+
+    StoreHeader *h = (StoreHeader*)base;
+    if (created) {
+        store_init_header(h, capacity, nslots, size);
+    } else {
+        for (int tries = 0; atomic_load_explicit(&h->magic, memory_order_acquire) != STORE_MAGIC; ++tries) {
+            if (tries > 1000) { munmap(base, size); return -4; }
+            usleep(1000);
+        }
+        if (h->version != STORE_VERSION || h->size != size) { munmap(base, size); return -6; }
+    }
+    store_bind(&g_store_obj, base, size, 0);
+    g_store = &g_store_obj;
+    return 0;
+}
+
+int pc_store_create(unsigned capacity) {
+    if (g_store) return -1;
+    if (capacity < 2) capacity = PC_STORE_DEFAULT_CAPACITY;
+    uint32_t nslots = 1;
+    while (nslots < 2u * capacity) nslots <<= 1;
+    size_t size = store_layout(capacity, nslots);
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return -5;
+    store_init_header((StoreHeader*)base, capacity, nslots, size);
+    store_bind(&g_store_obj, base, size, 1);
+    g_store = &g_store_obj;
+    return 0;
+}
+
+int pc_store_set_watermarks(unsigned high, unsigned low) {
+    if (!g_store || !g_store->reclaimable) return -1;
+    if (high && (low >= high || high >= g_store->hdr->capacity)) return -2;
+    g_store->high = high;
+    g_store->low = high ? low : 0;
+    return 0;
+}
+
+void pc_store_detach(void) {
+    if (!g_store) return;
+    munmap(g_store->hdr, g_store->map_size);
+    g_store = NULL;
+}
+
+/* Snapshots.  Because the store holds no pointers, a snapshot is just the
+   store image written to a file with the same layout as the mapping; the
+   unused tail of the entry array is left as a hole.  Restoring maps the file
+   privately (copy-on-write), so a new worker starts with every formula and
+   lemma already interned without re-parsing anything.  Restoring reads the
+   used entries and the slot table once to check them: a damaged file could
+   otherwise send lookups and sweeps outside the entry array. */
+
+static int write_all(int fd, const void *buf, size_t len, off_t off) {
+    const char *p = (const char*)buf;
+    while (len > 0) {
+        ssize_t w = pwrite(fd, p, len, off);
+        if (w <= 0) return 0;
+        p += w;
+        len -= (size_t)w;
+        off += w;
+    }
+    return 1;
+}
+
+int pc_store_snapshot(const char *path) {
+    if (!g_store || !path) return -1;
+    StoreHeader *h = g_store->hdr;
+    size_t slots_off = (size_t)((char*)g_store->slots - (char*)h);
+    size_t slots_len = (size_t)h->nslots * sizeof(uint32_t);
+
+    char tmp[4096];
+    if (snprintf(tmp, sizeof tmp, "%s.tmp", path) >= (int)sizeof tmp) return -1;
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -2;
+    int ok = ftruncate(fd, (off_t)g_store->map_size) == 0;
+
+    /* Slots first, then entries: every id read from a slot was published
+       before `count` is loaded below, so its entry is within the copied range. */
+    ok = ok && write_all(fd, (const void*)g_store->slots, slots_len, (off_t)slots_off);
+    uint32_t count = atomic_load_explicit(&h->count, memory_order_acquire);
+    if (count > h->capacity) count = h->capacity;
+    ok = ok && write_all(fd, g_store->entries, (size_t)count * sizeof(StoreEntry), (off_t)sizeof(StoreHeader));
+
+    StoreHeader out;
+    memset(&out, 0, sizeof out);
+    out.version = h->version;
+    out.capacity = h->capacity;
+    out.nslots = h->nslots;
+    atomic_store(&out.count, count);
+    atomic_store(&out.lemmas, atomic_load(&h->lemmas));
+    atomic_store(&out.epoch, atomic_load(&h->epoch));
+    out.size = h->size;
+    atomic_store(&out.magic, STORE_MAGIC);
+    ok = ok && write_all(fd, &out, sizeof out, 0);
+    ok = ok && fsync(fd) == 0;
+    if (close(fd) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) { unlink(tmp); return -3; }
+    return 0;
+}
+
+/* Entries must only point at earlier, written entries and slots at written
+   entries below count.  An all-zero entry is one a racing process allocated
+   but had not filled when the snapshot was taken; nothing refers to it. */
+static int store_valid(const StoreHeader *h, const StoreEntry *e, const uint32_t *slots) {
+    uint32_t n = atomic_load(&h->count);
+    if (n < 1 || n > h->capacity || atomic_load(&h->lemmas) >= n) return 0;
+    for (uint32_t id = 1; id < n; ++id) {
+        const StoreEntry *x = &e[id];
+        uint32_t flags = atomic_load_explicit(&x->flags, memory_order_relaxed);
+        if (flags & ~STORE_LEMMA) return 0;
+        int ok;
+        switch (x->kind) {
+        case 0:   ok = !flags && !x->atom && !x->left && !x->right; break;
+        case 'A': ok = isupper(x->atom) && !x->left && !x->right; break;
+        case 'N': ok = !x->atom && x->left && x->left < id && e[x->left].kind && !x->right; break;
+        case 'C': ok = !x->atom && x->left && x->left < id && e[x->left].kind
+                       && x->right && x->right < id && e[x->right].kind; break;
+        default:  ok = 0;
+        }
+        if (!ok) return 0;
+    }
+    for (uint32_t k = 0; k < h->nslots; ++k)
+        if (slots[k] && (slots[k] >= n || !e[slots[k]].kind)) return 0;
+    return 1;
+}
+
+int pc_store_restore(const char *path) {
+    if (!path || g_store) return -1;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -2;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size < (off_t)sizeof(StoreHeader)) { close(fd); return -3; }
+    size_t size = (size_t)sb.st_size;
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -4;
+    StoreHeader *h = (StoreHeader*)base;
+    if (atomic_load(&h->magic) != STORE_MAGIC || h->version != STORE_VERSION || h->size != size
+        || h->nslots == 0 || (h->nslots & (h->nslots - 1)) != 0
+        || store_layout(h->capacity, h->nslots) != size
+        || !store_valid(h, (const StoreEntry*)(h + 1), (const uint32_t*)((const StoreEntry*)(h + 1) + h->capacity))) {
+        munmap(base, size);
+        return -5;
+    }
+    store_bind(&g_store_obj, base, size, 1);
+    g_store = &g_store_obj;
+    return 0;
+}
+
+unsigned pc_store_intern(const char *formula) {
+    FormulaStore *st = g_store;
+    if (!st || !formula || !is_wff_str(formula)) return 0;
+    int idx = 0;
+    Node *n = parse_node(formula, &idx);
+    if (!n) return 0;
+    uint32_t gen = store_enter(st);
+    uint32_t id = intern_tree(st, n, gen);
+    store_leave(st);
+    free_tree(n);
+    return id;
+}
+
+int pc_store_stats(unsigned *formulas, unsigned *lemmas) {
+    if (!g_store) return -1;
+    uint32_t n = atomic_load(&g_store->hdr->count);
+    if (n > g_store->hdr->capacity) n = g_store->hdr->capacity;
+    if (formulas) *formulas = n - 1;
+    if (lemmas) *lemmas = atomic_load(&g_store->hdr->lemmas);
+    return 0;
+}
+
 /* ---------------- Pattern matching (axiom instance check) ---------------- */
 
 /* Bindings for pattern variables: map 'A'..'Z' -> Node* (NULL if unbound) */
@@ -248,6 +1426,7 @@ static void bindings_clear(Bindings *b) {
 
 /* Match pattern `p` against formula `f` with bindings `b`. */
 static int match_pattern_rec(Node *p, Node *f, Bindings *b) {
+    g_visits++;
     if (!p || !f) return 0;
     if (p->kind == 'A') {
         char var = p->atom;
@@ -269,20 +1448,31 @@ static int match_pattern_rec(Node *p, Node *f, Bindings *b) {
     return 0;
 }
 
-/* Top-level: check if formula AST `f` is an instance of axiom whose pattern is given by string pat_str. */
-static int is_instance_of_axiom_pattern(const char *pat_str, Node *f) {
-    int idx = 0;
-    Node *pattern = parse_node(pat_str, &idx);
-    if (!pattern) return 0;
-    skip_ws_str(pat_str, &idx);
-    if (idx != (int)strlen(pat_str)) {
-        free_tree(pattern);
-        return 0;
+/* Top-level: check if formula AST `f` is an instance of axiom whose pattern is given by string pat_str.
+   The parsed pattern is kept in *matcher, so each axiom is parsed once per process
+   rather than on every check. Threads racing on the first use each parse it and
+   only one copy is published. */
+static int is_instance_of_axiom_pattern(const char *pat_str, Node *_Atomic *matcher, Node *f) {
+    Node *pattern = atomic_load_explicit(matcher, memory_order_acquire);
+    if (!pattern) {
+        int idx = 0;
+        pattern = parse_node(pat_str, &idx);
+        if (!pattern) return 0;
+        skip_ws_str(pat_str, &idx);
+        if (idx != (int)strlen(pat_str)) {
+            free_tree(pattern);
+            return 0;
+        }
+        Node *expected = NULL;
+        if (!atomic_compare_exchange_strong_explicit(matcher, &expected, pattern,
+                                                     memory_order_acq_rel, memory_order_acquire)) {
+            free_tree(pattern);
+            pattern = expected;
+        }
     }
     Bindings b;
     bindings_init(&b);
     int ok = match_pattern_rec(pattern, f, &b);
-    free_tree(pattern);
     bindings_clear(&b);
     return ok;
 }
@@ -290,8 +1480,8 @@ static int is_instance_of_axiom_pattern(const char *pat_str, Node *f) {
 /* ---------------- Modus Ponens checking ---------------- */
 static int check_modus_ponens(Node *cur, int i, int j) {
     if (i < 1 || j < 1 || i > proof_count || j > proof_count) return 0;
-    Node *Ai = proof[i-1].formula_ast;
-    Node *Aj = proof[j-1].formula_ast;
+    Node *Ai = line_ast(i-1);
+    Node *Aj = line_ast(j-1);
     if (!Ai || !Aj) return 0;
 
     /* Case 1: Ai is A, Aj is c A B, cur equals B */
@@ -303,93 +1493,364 @@ static int check_modus_ponens(Node *cur, int i, int j) {
 
 /* ---------------- Substitution checking ---------------- */
 
-static Node *apply_subst(const Node *p, char var, const Node *replacement) {
-    if (!p) return NULL;
+/* Does substituting `replacement` for `var` in p give f? Walks p and f in
+   parallel instead of building the substituted tree, so a candidate line
+   costs at most |f| steps, allocates nothing and stops at the first
+   mismatch (checking a line against every earlier one used to clone the
+   replacement for each occurrence of var in each of them). */
+static int subst_equal(const Node *p, char var, const Node *replacement, const Node *f) {
+    g_visits++;
     if (p->kind == 'A') {
-        if (p->atom == var) {
-            return clone_tree(replacement);
-        } else {
-            Node *n = (Node*)malloc(sizeof(Node));
-            if (!n) { perror("malloc"); exit(EXIT_FAILURE); }
-            n->kind = 'A';
-            n->atom = p->atom;
-            n->left = n->right = NULL;
-            return n;
-        }
-    } else if (p->kind == 'N') {
-        Node *child = apply_subst(p->left, var, replacement);
-        Node *n = (Node*)malloc(sizeof(Node));
-        if (!n) { perror("malloc"); exit(EXIT_FAILURE); }
-        n->kind = 'N';
-        n->atom = 0;
-        n->left = child;
-        n->right = NULL;
-        return n;
-    } else { // 'C'
-        Node *L = apply_subst(p->left, var, replacement);
-        Node *R = apply_subst(p->right, var, replacement);
-        Node *n = (Node*)malloc(sizeof(Node));
-        if (!n) { perror("malloc"); exit(EXIT_FAILURE); }
-        n->kind = 'C';
-        n->atom = 0;
-        n->left = L;
-        n->right = R;
-        return n;
+        if (p->atom == var) return equal_tree(replacement, f);
+        return f->kind == 'A' && f->atom == p->atom;
     }
+    if (p->kind != f->kind) return 0;
+    if (p->kind == 'N') return subst_equal(p->left, var, replacement, f->left);
+    return subst_equal(p->left, var, replacement, f->left)
+        && subst_equal(p->right, var, replacement, f->right);
 }
 
-static int check_substitution(Node *current, const char *just) {
-    /* parse just: find uppercase var and '=' and rhs */
-    const char *p = just;
+/* Parse the "X=<wff>" part of a Substitution justification (the text after
+   the keyword). Returns the replacement AST and sets *var, or NULL. */
+static Node *parse_subst_args(const char *args, char *var) {
+    const char *p = args;
     while (*p && !isupper((unsigned char)*p)) p++;
-    if (!*p) return 0;
-    char var = *p;
-    const char *eq = strchr(just, '=');
-    if (!eq) return 0;
+    if (!*p) return NULL;
+    *var = *p;
+    const char *eq = strchr(p, '=');
+    if (!eq) return NULL;
     const char *rhs = eq + 1;
     while (*rhs && isspace((unsigned char)*rhs)) rhs++;
-    if (!*rhs) return 0;
-    if (!is_wff_str(rhs)) return 0;
+    if (!*rhs) return NULL;
+    if (!is_wff_str(rhs)) return NULL;
     int idx = 0;
     Node *replacement = parse_node(rhs, &idx);
-    if (!replacement) return 0;
+    if (!replacement) return NULL;
     skip_ws_str(rhs, &idx);
-    if (idx != (int)strlen(rhs)) { free_tree(replacement); return 0; }
+    if (idx != (int)strlen(rhs)) { free_tree(replacement); return NULL; }
+    return replacement;
+}
 
+/* On success *src_line is set to the index of the line the substitution was applied to. */
+static int check_substitution(Node *current, char var, const Node *replacement, int *src_line) {
     for (int k = 0; k < proof_count; ++k) {
-        Node *src = proof[k].formula_ast;
+        Node *src = line_ast(k);
         if (!src) continue;
-        Node *subs = apply_subst(src, var, replacement);
-        int ok = equal_tree(subs, current);
-        free_tree(subs);
-        if (ok) { free_tree(replacement); return 1; }
+        if (subst_equal(src, var, replacement, current)) { *src_line = k; return 1; }
     }
-    free_tree(replacement);
     return 0;
 }
 
+/* ---------------- Packed small formulas ---------------- */
+
+static int pack_code(char ch) {
+    if (ch == 'c') return 1;
+    if (ch == 'n') return 2;
+    return isupper((unsigned char)ch) ? ch - 'A' + 3 : 0;
+}
+
+static int pack_sym(const Packed *p, int k) {
+    return (int)(p->bits >> (PACK_BITS - 5 * (k + 1))) & 31;
+}
+
+/* Pack a whitespace-free formula. Returns 0 if it is not a WFF or has more
+   than PACK_MAX symbols (callers then take the Node path). */
+static int pack_formula(const char *s, Packed *out) {
+    PackWord bits = 0;
+    int need = 1, k = 0;
+    for (; s[k]; ++k) {
+        int code = pack_code(s[k]);
+        if (k == PACK_MAX || need == 0 || code == 0) return 0;
+        bits |= (PackWord)code << (PACK_BITS - 5 * (k + 1));
+        need += code == 1 ? 1 : code == 2 ? 0 : -1;
+    }
+    if (need != 0) return 0;
+    out->bits = bits;
+    out->len = k;
+    return 1;
+}
+
+/* End (exclusive) of the subformula starting at symbol k. */
+static int pack_span(const Packed *p, int k) {
+    int need = 1;
+    while (need) {
+        int code = pack_sym(p, k++);
+        need += code == 1 ? 1 : code == 2 ? 0 : -1;
+    }
+    return k;
+}
+
+/* Symbols [from, to) of p, moved to the top of the word. */
+static PackWord pack_sub(const Packed *p, int from, int to) {
+    PackWord mask = ~(~(PackWord)0 >> (5 * (to - from)));
+    return (p->bits << (5 * from)) & mask;
+}
+
+/* Is b the implication c a r? */
+static int pack_is_imp(const Packed *b, const Packed *a, const Packed *r) {
+    if (b->len != 1 + a->len + r->len) return 0;
+    PackWord expect = ((PackWord)1 << (PACK_BITS - 5)) | (a->bits >> 5) | (r->bits >> (5 * (1 + a->len)));
+    return b->bits == expect;
+}
+
+/* Match a packed formula against an axiom schema in prefix notation by
+   walking both left to right: connectives must agree, a schema variable
+   takes the next whole subformula, and a repeated variable must take an
+   equal one. */
+static int pack_match(const char *pat, const Packed *f) {
+    int from[26], to[26];
+    uint32_t bound = 0;
+    int k = 0;
+    for (const char *q = pat; *q; ++q) {
+        if (k >= f->len) return 0;
+        if (*q == 'c' || *q == 'n') {
+            if (pack_sym(f, k++) != pack_code(*q)) return 0;
+            continue;
+        }
+        int v = *q - 'A', end = pack_span(f, k);
+        if (bound & (1u << v)) {
+            if (end - k != to[v] - from[v] || pack_sub(f, k, end) != pack_sub(f, from[v], to[v])) return 0;
+        } else {
+            bound |= 1u << v;
+            from[v] = k;
+            to[v] = end;
+        }
+        k = end;
+    }
+    return k == f->len;
+}
+
+/* AST of line k, built from its text the first time a packed line needs one. */
+static Node *line_ast(int k) {
+    ProofLine *pl = &proof[k];
+    if (!pl->formula_ast && pl->packed.len) {
+        int idx = 0;
+        pl->formula_ast = parse_node(pl->formula_str, &idx);
+    }
+    return pl->formula_ast;
+}
+
+/* Modus Ponens for line index cur citing lines i and j (1-based). */
+static int check_mp_line(int cur, int i, int j) {
+    if (i < 1 || j < 1 || i > proof_count || j > proof_count) return 0;
+    const Packed *c = &proof[cur].packed, *a = &proof[i-1].packed, *b = &proof[j-1].packed;
+    if (c->len && a->len && b->len) return pack_is_imp(b, a, c) || pack_is_imp(a, b, c);
+    return check_modus_ponens(line_ast(cur), i, j);
+}
+
 /* ---------------- Top-level axiom patterns ---------------- */
 static const char *AX1_PAT = "cPcQP";
 static const char *AX2_PAT = "ccScPQccSPcSQ";
 static const char *AX3_PAT = "ccnPnQcQP";
 
-static int is_instance_AX1(Node *f) { return is_instance_of_axiom_pattern(AX1_PAT, f); }
-static int is_instance_AX2(Node *f) { return is_instance_of_axiom_pattern(AX2_PAT, f); }
-static int is_instance_AX3(Node *f) { return is_instance_of_axiom_pattern(AX3_PAT, f); }
+/* Parsed axiom patterns, kept warm across verify_proof calls */
+static Node *_Atomic AX1_MATCHER = NULL;
+static Node *_Atomic AX2_MATCHER = NULL;
+static Node *_Atomic AX3_MATCHER = NULL;
 
-/* ---------------- Input parsing and checking driver ---------------- */
+static int is_instance_AX1(Node *f) { return is_instance_of_axiom_pattern(AX1_PAT, &AX1_MATCHER, f); }
+static int is_instance_AX2(Node *f) { return is_instance_of_axiom_pattern(AX2_PAT, &AX2_MATCHER, f); }
+static int is_instance_AX3(Node *f) { return is_instance_of_axiom_pattern(AX3_PAT, &AX3_MATCHER, f); }
 
-/* Trim leading/trailing whitespace from a C string (in place) */
-static void trim_inplace(char *s) {
-    if (!s) return;
-    int n = (int)strlen(s);
-    int i = 0;
-    while (i < n && isspace((unsigned char)s[i])) i++;
-    if (i > 0) memmove(s, s + i, n - i + 1);
-    n = (int)strlen(s);
-    while (n > 0 && isspace((unsigned char)s[n-1])) s[--n] = '\0';
+/* ---------------- Back-reference compressed formulas ---------------- */
+
+/* Large proofs repeat big subformulas, so a formula token may use
+   back-references instead of spelling them out (in the spirit of Metamath's
+   compressed proofs):
+     @k   the formula of line k (an earlier line)
+     *F   the subformula F, which also becomes definition number 1, 2, ...
+          (numbered in order of appearance across the whole proof)
+     $k   definition number k
+   Digits never start a formula, so numbers need no terminator: "c@3$12" is
+   c <line 3> <definition 12>. References are decoded straight into ASTs
+   (and from there into the formula store); the text is never expanded. */
+
+static _Thread_local Node **g_defs = NULL;
+static _Thread_local int g_defs_count = 0;
+static _Thread_local int g_defs_cap = 0;
+
+static int is_compressed_str(const char *s) {
+    return strpbrk(s, "@$*") != NULL;
+}
+
+static int read_ref_number(const char *s, int *idx) {
+    if (!isdigit((unsigned char)s[*idx])) return -1;
+    long v = 0;
+    while (isdigit((unsigned char)s[*idx])) {
+        v = v * 10 + (s[*idx] - '0');
+        if (v > 1000000000L) return -1;
+        (*idx)++;
+    }
+    return (int)v;
+}
+
+/* Parse a possibly compressed formula for line index `line` (0-based). */
+static Node *parse_compressed(const char *s, int *idx, int line) {
+    char tok = s[*idx];
+    if (tok == '@') {
+        (*idx)++;
+        int k = read_ref_number(s, idx);
+        if (k < 1 || k > line || !line_ast(k-1)) return NULL;
+        return clone_tree(proof[k-1].formula_ast);
+    }
+    if (tok == '$') {
+        (*idx)++;
+        int k = read_ref_number(s, idx);
+        if (k < 1 || k > g_defs_count || !g_defs[k-1]) return NULL;
+        return clone_tree(g_defs[k-1]);
+    }
+    if (tok == '*') {
+        (*idx)++;
+        if (g_defs_count == g_defs_cap) {
+            int nc = g_defs_cap ? g_defs_cap * 2 : 64;
+            Node **nd = (Node**)realloc(g_defs, (size_t)nc * sizeof(Node*));
+            if (!nd) { perror("realloc"); exit(EXIT_FAILURE); }
+            g_defs = nd;
+            g_defs_cap = nc;
+        }
+        int slot = g_defs_count++;
+        g_defs[slot] = NULL;      // not usable inside its own definition
+        Node *n = parse_compressed(s, idx, line);
+        /* the definition aliases the line's tree, which lives until cleanup */
+        g_defs[slot] = n;
+        return n;
+    }
+    if (isupper((unsigned char)tok)) {
+        Node *node = (Node*)malloc(sizeof(Node));
+        if (!node) { perror("malloc"); exit(EXIT_FAILURE); }
+        node->kind = 'A';
+        node->atom = tok;
+        node->id = 0;
+        node->left = node->right = NULL;
+        (*idx)++;
+        return node;
+    }
+    if (tok == 'n' || tok == 'c') {
+        (*idx)++;
+        Node *left = parse_compressed(s, idx, line);
+        if (!left) return NULL;
+        Node *right = NULL;
+        if (tok == 'c') {
+            right = parse_compressed(s, idx, line);
+            if (!right) { free_tree(left); return NULL; }
+        }
+        Node *node = (Node*)malloc(sizeof(Node));
+        if (!node) { perror("malloc"); exit(EXIT_FAILURE); }
+        node->kind = tok == 'c' ? 'C' : 'N';
+        node->atom = 0;
+        node->id = 0;
+        node->left = left;
+        node->right = right;
+        return node;
+    }
+    return NULL;
+}
+
+static void free_defs(void) {
+    free(g_defs);
+    g_defs = NULL;
+    g_defs_count = g_defs_cap = 0;
+}
+
+/* Compressor: subformulas of at least COMPRESS_MIN_SIZE symbols that occur
+   more than once are defined at their first occurrence and referenced after
+   that; a line repeating an earlier line's formula becomes @k. */
+#define COMPRESS_MIN_SIZE 4
+
+typedef struct {
+    const Node *rep;
+    uint32_t hash;
+    uint32_t size;
+    uint32_t count;
+    int def;              // definition number once emitted (0 = not yet)
+} SubtermInfo;
+
+typedef struct {
+    SubtermInfo *tab;
+    size_t mask;
+    int next_def;
+} SubtermTable;
+
+static uint32_t subterm_hash(const Node *n, uint32_t *size) {
+    if (n->kind == 'A') { *size = 1; return 0x9E3779B1u * (uint32_t)(unsigned char)n->atom; }
+    uint32_t ls = 0, rs = 0;
+    uint32_t h = subterm_hash(n->left, &ls);
+    if (n->kind == 'N') { *size = ls + 1; return (h ^ 0x85EBCA6Bu) * 0xC2B2AE35u + 1; }
+    uint32_t r = subterm_hash(n->right, &rs);
+    *size = ls + rs + 1;
+    return ((h * 31u) ^ (r + 0x27D4EB2Fu)) * 0x165667B1u + 2;
+}
+
+static SubtermInfo *subterm_lookup(SubtermTable *t, const Node *n, uint32_t h, uint32_t size) {
+    size_t pos = h & t->mask;
+    while (t->tab[pos].rep) {
+        SubtermInfo *e = &t->tab[pos];
+        if (e->hash == h && e->size == size && equal_tree(e->rep, n)) return e;
+        pos = (pos + 1) & t->mask;
+    }
+    t->tab[pos].rep = n;
+    t->tab[pos].hash = h;
+    t->tab[pos].size = size;
+    return &t->tab[pos];
+}
+
+static void subterm_count(SubtermTable *t, const Node *n) {
+    uint32_t size = 0;
+    uint32_t h = subterm_hash(n, &size);
+    if (size >= COMPRESS_MIN_SIZE) subterm_lookup(t, n, h, size)->count++;
+    if (n->left && size > COMPRESS_MIN_SIZE) subterm_count(t, n->left);
+    if (n->right && size > COMPRESS_MIN_SIZE) subterm_count(t, n->right);
+}
+
+static int subterm_emit(SubtermTable *t, const Node *n, StrBuf *sb) {
+    uint32_t size = 0;
+    uint32_t h = subterm_hash(n, &size);
+    if (size >= COMPRESS_MIN_SIZE) {
+        SubtermInfo *e = subterm_lookup(t, n, h, size);
+        if (e->def) return sb_appendf(sb, "$%d", e->def);
+        if (e->count > 1) {
+            e->def = ++t->next_def;
+            if (!sb_appendf(sb, "*")) return 0;
+        }
+    }
+    if (n->kind == 'A') return sb_appendf(sb, "%c", n->atom);
+    if (!sb_appendf(sb, "%c", n->kind == 'N' ? 'n' : 'c')) return 0;
+    if (!subterm_emit(t, n->left, sb)) return 0;
+    return n->kind == 'N' || subterm_emit(t, n->right, sb);
+}
+
+/* Emit the (parsed) proof array in compressed form into sb. */
+static int compress_proof(StrBuf *sb) {
+    size_t nodes = 0;
+    for (int i = 0; i < proof_count; ++i) nodes += tree_size(line_ast(i));
+    size_t cap = 16;
+    while (cap < 2 * nodes) cap <<= 1;
+    SubtermTable t;
+    t.tab = (SubtermInfo*)calloc(cap, sizeof(SubtermInfo));
+    t.mask = cap - 1;
+    t.next_def = 0;
+    if (!t.tab) return 0;
+    for (int i = 0; i < proof_count; ++i) subterm_count(&t, proof[i].formula_ast);
+
+    int ok = 1;
+    for (int i = 0; i < proof_count && ok; ++i) {
+        ok = sb_appendf(sb, "%d ", proof[i].line_no);
+        int same = 0;
+        for (int k = 0; k < i && ok && !same; ++k) {
+            if (equal_tree(proof[k].formula_ast, proof[i].formula_ast)) {
+                same = 1;
+                ok = sb_appendf(sb, "@%d", proof[k].line_no);
+            }
+        }
+        if (ok && !same) ok = subterm_emit(&t, proof[i].formula_ast, sb);
+        if (ok) ok = sb_appendf(sb, " %s\n", proof[i].just ? proof[i].just : "");
+    }
+    free(t.tab);
+    return ok;
 }
 
+/* ---------------- Input parsing and checking driver ---------------- */
+
 /* Remove all whitespace characters from a string, in place */
 static void clean_inplace(char *s) {
     char *p = s, *q = s;
@@ -402,117 +1863,336 @@ static void clean_inplace(char *s) {
     *q = '\0';
 }
 
-/* Read proof from a FILE* (lines). Returns 0 on success, negative on error. */
-static int read_proof_from_file(FILE *fp) {
-    char buf[4096];
+static int is_space_char(char c) { return isspace((unsigned char)c) != 0; }
+
+/* Read proof lines from the span buf[0..len) (need not be NUL-terminated).
+   Only the formula and justification tokens are copied; lines may be of any
+   length. Returns 0 on success, negative on error. */
+static int read_proof_from_span(const char *buf, size_t len) {
+    const char *end = buf + len;
     int expected_line = 1;
     proof_count = 0; // reset
-    while (fgets(buf, sizeof buf, fp)) {
-        char *nl = strchr(buf, '\n');
-        if (nl) *nl = '\0';
-        char *p = buf;
-        while (*p && isspace((unsigned char)*p)) p++;
-        if (*p == '\0' || *p == '#') continue;
-
-        int lineno = 0;
-        int consumed = 0;
-        if (sscanf(p, "%d%n", &lineno, &consumed) != 1) {
-            out_append("Bad input line (missing line number): %s\n", buf);
-            return -1;
-        }
-        p += consumed;
-        while (*p && isspace((unsigned char)*p)) p++;
-        if (!*p) { out_append("Missing formula on line %d\n", lineno); return -2; }
+    for (const char *line = buf; line < end; ) {
+        const char *eol = (const char*)memchr(line, '\n', (size_t)(end - line));
+        if (!eol) eol = end;
+        const char *p = line;
+        const char *q = eol;
+        line = eol + 1;
+        while (p < q && is_space_char(*p)) p++;
+        if (p == q || *p == '#') continue;
 
-        char formula_token[1024];
-        int fi = 0;
-        while (*p && !isspace((unsigned char)*p)) {
-            if (fi < (int)sizeof(formula_token)-1) formula_token[fi++] = *p;
+        /* line number: optional sign and digits, as sscanf("%d") accepted */
+        const char *num = p;
+        int neg = 0;
+        long lineno = 0;
+        if (p < q && (*p == '+' || *p == '-')) neg = (*p++ == '-');
+        const char *digits = p;
+        while (p < q && isdigit((unsigned char)*p)) {
+            if (lineno < 1000000000L) lineno = lineno * 10 + (*p - '0');
             p++;
         }
-        formula_token[fi] = '\0';
-        while (*p && isspace((unsigned char)*p)) p++;
-        char *just_str = strdup(p);
-        if (!just_str) { out_append("Memory error\n"); return -3; }
-        trim_inplace(just_str);
+        if (p == digits) {
+            out_append("Bad input line (missing line number): %.*s\n", (int)(eol - num), num);
+            return -1;
+        }
+        if (neg) lineno = -lineno;
+        while (p < q && is_space_char(*p)) p++;
+        if (p == q) { out_append("Missing formula on line %ld\n", lineno); return -2; }
+
+        const char *f = p;
+        while (p < q && !is_space_char(*p)) p++;
+        const char *f_end = p;
+        while (p < q && is_space_char(*p)) p++;
+        while (q > p && is_space_char(q[-1])) q--;
 
         if (lineno != expected_line) {
-            out_append("Line numbers must be consecutive starting at 1 (expected %d but got %d)\n", expected_line, lineno);
-            free(just_str);
+            out_append("Line numbers must be consecutive starting at 1 (expected %d but got %ld)\n", expected_line, lineno);
             return -4;
         }
         expected_line++;
 
+        char *formula_str = strndup(f, (size_t)(f_end - f));
+        char *just_str = strndup(p, (size_t)(q - p));
+        if (!formula_str || !just_str) {
+            free(formula_str);
+            free(just_str);
+            out_append("Memory error\n");
+            return -3;
+        }
         ensure_proof_capacity();
-        proof[proof_count].line_no = lineno;
-        proof[proof_count].formula_str = strdup(formula_token);
+        proof[proof_count].line_no = (int)lineno;
+        proof[proof_count].formula_str = formula_str;
         proof[proof_count].formula_ast = NULL;
+        proof[proof_count].packed.len = 0;
         proof[proof_count].just = just_str;
+        proof[proof_count].rule = RULE_UNPARSED;
+        proof[proof_count].arg1 = proof[proof_count].arg2 = 0;
+        proof[proof_count].subst_var = 0;
+        proof[proof_count].subst_ast = NULL;
         proof_count++;
     }
     return 0;
 }
 
 /* Parse all formulas into ASTs and validate syntactic WFF */
-static int parse_all_formulas(void) {
-    for (int i = 0; i < proof_count; ++i) {
-        clean_inplace(proof[i].formula_str);
-        const char *fs = proof[i].formula_str;
-        if (!is_wff_str(fs)) {
-            out_append("Line %d: formula is not a WFF: \"%s\"\n", proof[i].line_no, fs);
-            return 0;
-        }
+/* Parse the formula of line i into its AST. Returns 1 on success; on
+   failure the error has been appended to the output. */
+static int parse_line_formula(int i) {
+    clean_inplace(proof[i].formula_str);
+    const char *fs = proof[i].formula_str;
+    if (is_compressed_str(fs)) {
         int idx = 0;
-        proof[i].formula_ast = parse_node(fs, &idx);
-        skip_ws_str(fs, &idx);
-        if (idx != (int)strlen(fs) || proof[i].formula_ast == NULL) {
-            out_append("Internal parse error at line %d\n", proof[i].line_no);
+        proof[i].formula_ast = parse_compressed(fs, &idx, i);
+        if (proof[i].formula_ast == NULL || fs[idx] != '\0') {
+            out_append("Line %d: formula is not a WFF (or has a bad back-reference): \"%s\"\n", proof[i].line_no, shown(fs, 0));
             return 0;
         }
+        if (g_store && g_gen) intern_tree(g_store, proof[i].formula_ast, g_gen);
+        return 1;
     }
+    /* without a store there are no ids to intern, so small formulas stay packed */
+    if (!g_store && pack_formula(fs, &proof[i].packed)) return 1;
+    if (!is_wff_str(fs)) {
+        out_append("Line %d: formula is not a WFF: \"%s\"\n", proof[i].line_no, shown(fs, 0));
+        return 0;
+    }
+    int idx = 0;
+    proof[i].formula_ast = parse_node(fs, &idx);
+    skip_ws_str(fs, &idx);
+    if (idx != (int)strlen(fs) || proof[i].formula_ast == NULL) {
+        out_append("Internal parse error at line %d\n", proof[i].line_no);
+        return 0;
+    }
+    if (g_store && g_gen) intern_tree(g_store, proof[i].formula_ast, g_gen);
     return 1;
 }
 
-/* Check each line's justification and append status into output buffer. Returns 1 if all ok, 0 otherwise. */
-static int check_proof(void) {
-    int all_ok = 1;
+static int parse_all_formulas(void) {
     for (int i = 0; i < proof_count; ++i) {
-        ProofLine *pl = &proof[i];
-        int ok = 0;
-        if (pl->just == NULL) {
-            ok = 0;
-        } else if (strcasecmp(pl->just, "Premise") == 0) {
-            ok = 1;
-        } else if (strcasecmp(pl->just, "AX1") == 0) {
-            ok = is_instance_AX1(pl->formula_ast);
-        } else if (strcasecmp(pl->just, "AX2") == 0) {
-            ok = is_instance_AX2(pl->formula_ast);
-        } else if (strcasecmp(pl->just, "AX3") == 0) {
-            ok = is_instance_AX3(pl->formula_ast);
-        } else if (strncasecmp(pl->just, "MP", 2) == 0) {
-            int a = -1, b = -1;
-            const char *s = pl->just + 2;
-            if (sscanf(s, " %d %d", &a, &b) < 2) {
-                out_append("Line %d: bad MP justification format: \"%s\"\n", pl->line_no, pl->just);
-                ok = 0;
-            } else {
-                ok = check_modus_ponens(pl->formula_ast, a, b);
-            }
-        } else if (strncasecmp(pl->just, "Substitution", 12) == 0) {
-            ok = check_substitution(pl->formula_ast, pl->just);
-        } else {
-            out_append("Line %d: unknown justification: \"%s\"\n", pl->line_no, pl->just);
-            ok = 0;
+        PHASE_HOOK(PC_HIST_PARSE_NS, i, 0);
+        int ok = parse_line_formula(i);
+        PHASE_HOOK(PC_HIST_PARSE_NS, i, 1);
+        if (!ok) {
+            PC_PROBE2(parse__fail, proof[i].line_no, -202);
+            return 0;
         }
+    }
+    return 1;
+}
 
-        if (ok) {
-            out_append("Line %d: OK: %s    [%s]\n", pl->line_no, pl->formula_str, pl->just);
+/* Check each line's justification and append status into output buffer. Returns 1 if all ok, 0 otherwise. */
+/* Premises and goal of the running verify_proof_goal call (unused otherwise) */
+static _Thread_local int g_check_premises = 0;
+static _Thread_local Node **g_premise_asts = NULL;
+static _Thread_local int g_n_premises = 0;
+static _Thread_local Node *g_goal_ast = NULL;
+
+static int premise_allowed(const Node *f) {
+    if (!g_check_premises) return 1;
+    for (int k = 0; k < g_n_premises; ++k)
+        if (equal_tree(g_premise_asts[k], f)) return 1;
+    return 0;
+}
+
+/* Classify a line's justification text into its rule and operands. */
+static void classify_justification(ProofLine *pl) {
+    const char *j = pl->just;
+    if (j == NULL) {
+        pl->rule = RULE_UNKNOWN;
+    } else if (strcasecmp(j, "Premise") == 0) {
+        pl->rule = RULE_PREMISE;
+    } else if (strcasecmp(j, "Lemma") == 0) {
+        pl->rule = RULE_LEMMA;
+    } else if (strcasecmp(j, "AX1") == 0) {
+        pl->rule = RULE_AX1;
+    } else if (strcasecmp(j, "AX2") == 0) {
+        pl->rule = RULE_AX2;
+    } else if (strcasecmp(j, "AX3") == 0) {
+        pl->rule = RULE_AX3;
+    } else if (strncasecmp(j, "MP", 2) == 0) {
+        int a = -1, b = -1;
+        if (sscanf(j + 2, " %d %d", &a, &b) < 2) {
+            pl->rule = RULE_BAD_MP;
         } else {
-            out_append("Line %d: INVALID: %s    [%s]\n", pl->line_no, pl->formula_str, pl->just);
-            all_ok = 0;
+            pl->rule = RULE_MP;
+            pl->arg1 = a;
+            pl->arg2 = b;
         }
+    } else if (strncasecmp(j, "Substitution", 12) == 0) {
+        pl->subst_ast = parse_subst_args(j + 12, &pl->subst_var);
+        pl->rule = pl->subst_ast ? RULE_SUBST : RULE_BAD_SUBST;
+    } else {
+        pl->rule = RULE_UNKNOWN;
+    }
+}
+
+/* ---------------- Streaming results ---------------- */
+
+static const char *RULE_NAMES[RULE_COUNT];
+
+/* Hand the pending messages (if any) to the callback and clear them. */
+static int stream_emit(const pc_line_result *r) {
+    int more = g_stream.cb(r, g_stream.ctx) == 0;
+    if (!more) g_stream.stopped = 1;
+    g_out->len = 0;
+    g_out->buf[0] = '\0';
+    return more;
+}
+
+/* A message that belongs to no line's verdict (read or parse errors, the goal check). */
+static void stream_message(void) {
+    pc_line_result r = { 0, 0, NULL, NULL, NULL, g_out->buf };
+    stream_emit(&r);
+}
+
+/* The verdict of one line, with the messages its check produced. */
+static int stream_line(const ProofLine *pl, int ok) {
+    pc_line_result r = {
+        pl->line_no, ok, RULE_NAMES[pl->rule], pl->formula_str, pl->just,
+        g_out->len ? g_out->buf : NULL,
+    };
+    g_stream.in_line = 0;
+    return stream_emit(&r);
+}
+
+/* Running verdict of a check_proof pass. */
+typedef struct {
+    int all_ok;
+    /* a valid proof whose lines only depend on earlier lines and which uses no
+       premises proves theorems; those are recorded as lemmas in the store */
+    int theorems;
+    int stopped;          // a stream callback asked to stop
+} CheckState;
+
+/* Check line i's justification and append its status to the output.
+   Returns 1 if the line is valid. */
+static int check_line(int i, CheckState *cs) {
+    ProofLine *pl = &proof[i];
+    int ok = 0;
+    int src = -1;
+    g_stream.in_line = g_stream.cb != NULL;
+    if (pl->rule == RULE_UNPARSED) classify_justification(pl);
+    switch (pl->rule) {
+    case RULE_PREMISE:
+        ok = !g_check_premises || premise_allowed(line_ast(i));
+        if (!ok) out_append("Line %d: not one of the given premises\n", pl->line_no);
+        cs->theorems = 0;
+        break;
+    case RULE_LEMMA:
+        ok = g_store && store_is_lemma(g_store, line_ast(i)->id);
+        break;
+    case RULE_AX1:
+        ok = pl->packed.len ? pack_match(AX1_PAT, &pl->packed) : is_instance_AX1(pl->formula_ast);
+        break;
+    case RULE_AX2:
+        ok = pl->packed.len ? pack_match(AX2_PAT, &pl->packed) : is_instance_AX2(pl->formula_ast);
+        break;
+    case RULE_AX3:
+        ok = pl->packed.len ? pack_match(AX3_PAT, &pl->packed) : is_instance_AX3(pl->formula_ast);
+        break;
+    case RULE_MP:
+        ok = check_mp_line(i, pl->arg1, pl->arg2);
+        if (pl->arg1 > i || pl->arg2 > i) cs->theorems = 0;
+        break;
+    case RULE_BAD_MP:
+        out_append("Line %d: bad MP justification format: \"%s\"\n", pl->line_no, shown(pl->just, 1));
+        ok = 0;
+        break;
+    case RULE_SUBST:
+        ok = check_substitution(line_ast(i), pl->subst_var, pl->subst_ast, &src);
+        if (src >= i) cs->theorems = 0;
+        break;
+    case RULE_BAD_SUBST:
+        ok = 0;
+        break;
+    default:
+        if (pl->just) out_append("Line %d: unknown justification: \"%s\"\n", pl->line_no, shown(pl->just, 1));
+        ok = 0;
+        break;
+    }
+
+    if (!ok) cs->all_ok = 0;
+    if (g_stream.cb) {
+        if (!stream_line(pl, ok)) cs->stopped = 1;
+    } else if (ok) {
+        out_append("Line %d: OK: %s    [%s]\n", pl->line_no, shown(pl->formula_str, 0), shown(pl->just, 1));
+    } else {
+        out_append("Line %d: INVALID: %s    [%s]\n", pl->line_no, shown(pl->formula_str, 0), shown(pl->just, 1));
+    }
+    return ok;
+}
+
+/* Whole-proof checks after every line was checked; returns the verdict. */
+static int check_finish(CheckState *cs) {
+    /* a stream stopped early left lines unchecked: no verdict, no lemmas */
+    if (cs->stopped) return cs->all_ok = 0;
+    if (g_goal_ast && (proof_count == 0 || !equal_tree(line_ast(proof_count-1), g_goal_ast))) {
+        out_append("Goal not reached: the last line is not the goal\n");
+        cs->all_ok = 0;
+    }
+    if (cs->all_ok && cs->theorems && g_store) {
+        for (int i = 0; i < proof_count; ++i) store_add_lemma(g_store, proof[i].formula_ast->id);
+    }
+    return cs->all_ok;
+}
+
+/* ---------------- Per-line profile ---------------- */
+
+static const char *RULE_NAMES[RULE_COUNT] = {
+    "unparsed", "Premise", "AX1", "AX2", "AX3", "MP", "Substitution", "Lemma",
+    "bad MP", "bad Substitution", "unknown",
+};
+
+_Static_assert(PC_PROFILE_RULES == RULE_COUNT, "pc_profile.by_rule must have a slot per rule");
+
+/* Profile being filled in by verify_proof_profile on this thread (or NULL). */
+static _Thread_local pc_profile *g_prof = NULL;
+
+static void profile_line(pc_profile *prof, int i, uint64_t ns, unsigned long visited) {
+    Rule r = proof[i].rule;
+    pc_rule_cost *rc = &prof->by_rule[r];
+    rc->rule = RULE_NAMES[r];
+    rc->lines++;
+    rc->visited += visited;
+    rc->ns += ns;
+    prof->check_ns += ns;
+    prof->visited += visited;
+    if (prof->k == 0) return;
+    /* keep the k most expensive lines sorted by time, descending */
+    int pos = prof->n_top;
+    if (pos == prof->k) {
+        if (ns <= prof->top[pos - 1].ns) return;
+        pos--;
+    } else {
+        prof->n_top++;
     }
-    return all_ok;
+    while (pos > 0 && prof->top[pos - 1].ns < ns) {
+        prof->top[pos] = prof->top[pos - 1];
+        pos--;
+    }
+    pc_line_cost *e = &prof->top[pos];
+    e->line = proof[i].line_no;
+    e->rule = RULE_NAMES[r];
+    e->size = proof[i].packed.len ? (unsigned long)proof[i].packed.len
+                                  : (unsigned long)tree_size(proof[i].formula_ast);
+    e->visited = visited;
+    e->ns = ns;
+}
+
+static int check_proof(void) {
+    CheckState cs = { 1, 1, 0 };
+    pc_profile *prof = g_prof;
+    for (int i = 0; i < proof_count && !cs.stopped; ++i) {
+        uint64_t t0 = prof ? trace_now() : trace_begin();
+        unsigned long v0 = g_visits;
+        PHASE_HOOK(PC_HIST_CHECK_NS, i, 0);
+        int ok = check_line(i, &cs);
+        PHASE_HOOK(PC_HIST_CHECK_NS, i, 1);
+        PC_PROBE3(line__checked, proof[i].line_no, (int)proof[i].rule, ok);
+        uint64_t ns = trace_end(RULE_SPAN[proof[i].rule], t0, "line", proof[i].line_no);
+        if (prof) profile_line(prof, i, ns, g_visits - v0);
+    }
+    return check_finish(&cs);
 }
 
 /* Cleanup proof memory */
@@ -521,21 +2201,330 @@ static void cleanup_proof(void) {
         free(proof[i].formula_str);
         free(proof[i].just);
         free_tree(proof[i].formula_ast);
+        free_tree(proof[i].subst_ast);
     }
+    free_defs();
     free(proof);
     proof = NULL;
     proof_capacity = proof_count = 0;
 }
 
+/* ---------------- Binary pre-parsed proof format ---------------- */
+
+/* Layout (native byte order, every section 4-byte aligned):
+     PcbHeader
+     uint32_t offsets[n_formulas + 1]   formula i is symbols[offsets[i] .. offsets[i+1])
+     char     symbols[n_symbols]        prefix-array formulas ('c', 'n', 'A'..'Z'), padded to 4
+     PcbLine  lines[n_lines]            line k is proof line k+1
+   Formulas are deduplicated, and every formula in the table is validated as
+   a WFF when the file is opened, so the loader only decodes prefix arrays
+   into ASTs and never tokenizes or parses text. Justifications are stored as
+   Rule values with their operands. */
+
+#define PCB_MAGIC   "PCBF"
+#define PCB_VERSION 1u
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t n_formulas;
+    uint32_t n_lines;
+    uint32_t n_symbols;
+    uint32_t reserved;
+} PcbHeader;
+
+typedef struct {
+    uint32_t formula;     // index into the formula table
+    uint8_t rule;         // Rule
+    uint8_t var;          // Substitution variable
+    uint16_t reserved;
+    int32_t arg1;         // MP: first line; Substitution: replacement formula index
+    int32_t arg2;         // MP: second line
+} PcbLine;
+
+typedef struct {
+    const PcbHeader *hdr;
+    const uint32_t *offsets;
+    const char *symbols;
+    const PcbLine *lines;
+} PcbView;
+
+#define PCB_ALIGN4(n) (((n) + 3u) & ~(size_t)3u)
+
+/* Check that sym[0..len) is exactly one formula in prefix form. */
+static int pcb_valid_formula(const char *sym, uint32_t len) {
+    uint32_t need = 1;
+    for (uint32_t k = 0; k < len; ++k) {
+        if (need == 0) return 0;
+        char t = sym[k];
+        if (isupper((unsigned char)t)) need--;
+        else if (t == 'c') need++;
+        else if (t != 'n') return 0;
+    }
+    return need == 0;
+}
+
+/* Validate a binary proof and set up a view of its sections. Returns 1 if ok. */
+static int pcb_open(const void *buf, size_t len, PcbView *v) {
+    if (!buf || len < sizeof(PcbHeader) || ((uintptr_t)buf & 3u)) return 0;
+    const PcbHeader *h = (const PcbHeader*)buf;
+    if (memcmp(h->magic, PCB_MAGIC, 4) != 0 || h->version != PCB_VERSION) return 0;
+    uint64_t need = sizeof(PcbHeader)
+                  + ((uint64_t)h->n_formulas + 1) * sizeof(uint32_t)
+                  + PCB_ALIGN4((uint64_t)h->n_symbols)
+                  + (uint64_t)h->n_lines * sizeof(PcbLine);
+    if (need != len) return 0;
+    v->hdr = h;
+    v->offsets = (const uint32_t*)(h + 1);
+    v->symbols = (const char*)(v->offsets + h->n_formulas + 1);
+    v->lines = (const PcbLine*)(v->symbols + PCB_ALIGN4((size_t)h->n_symbols));
+    if (v->offsets[0] != 0 || v->offsets[h->n_formulas] != h->n_symbols) return 0;
+    for (uint32_t i = 0; i < h->n_formulas; ++i) {
+        uint32_t a = v->offsets[i], b = v->offsets[i + 1];
+        if (a > b || b > h->n_symbols) return 0;
+        if (!pcb_valid_formula(v->symbols + a, b - a)) return 0;
+    }
+    for (uint32_t k = 0; k < h->n_lines; ++k) {
+        const PcbLine *ln = &v->lines[k];
+        if (ln->formula >= h->n_formulas) return 0;
+        if (ln->rule < RULE_PREMISE || ln->rule > RULE_LEMMA) return 0;
+        if (ln->rule == RULE_SUBST) {
+            if (!isupper(ln->var) || ln->arg1 < 0 || (uint32_t)ln->arg1 >= h->n_formulas) return 0;
+        }
+    }
+    return 1;
+}
+
+/* Decode a validated prefix array into an AST. */
+static Node *pcb_decode(const char *sym, uint32_t *pos) {
+    char t = sym[(*pos)++];
+    Node *node = (Node*)malloc(sizeof(Node));
+    if (!node) { perror("malloc"); exit(EXIT_FAILURE); }
+    node->id = 0;
+    node->left = node->right = NULL;
+    if (t == 'c') {
+        node->kind = 'C';
+        node->atom = 0;
+        node->left = pcb_decode(sym, pos);
+        node->right = pcb_decode(sym, pos);
+    } else if (t == 'n') {
+        node->kind = 'N';
+        node->atom = 0;
+        node->left = pcb_decode(sym, pos);
+    } else {
+        node->kind = 'A';
+        node->atom = t;
+    }
+    return node;
+}
+
+static Node *pcb_formula_ast(const PcbView *v, uint32_t f) {
+    uint32_t pos = 0;
+    return pcb_decode(v->symbols + v->offsets[f], &pos);
+}
+
+static char *pcb_formula_str(const PcbView *v, uint32_t f) {
+    return strndup(v->symbols + v->offsets[f], v->offsets[f + 1] - v->offsets[f]);
+}
+
+/* Rebuild the justification text of a binary line (used for reports). */
+static char *pcb_just_str(const PcbView *v, const PcbLine *ln) {
+    char head[64];
+    switch (ln->rule) {
+    case RULE_PREMISE: return strdup("Premise");
+    case RULE_AX1: return strdup("AX1");
+    case RULE_AX2: return strdup("AX2");
+    case RULE_AX3: return strdup("AX3");
+    case RULE_LEMMA: return strdup("Lemma");
+    case RULE_MP:
+        snprintf(head, sizeof head, "MP %d %d", (int)ln->arg1, (int)ln->arg2);
+        return strdup(head);
+    default: {
+        uint32_t a = v->offsets[ln->arg1], b = v->offsets[ln->arg1 + 1];
+        char *j = (char*)malloc(16 + (b - a));
+        if (!j) return NULL;
+        int n = sprintf(j, "Substitution %c=", ln->var);
+        memcpy(j + n, v->symbols + a, b - a);
+        j[n + (b - a)] = '\0';
+        return j;
+    }
+    }
+}
+
+/* Fill the proof array from a validated binary proof. Returns 0 on success. */
+static int load_binary_proof(const PcbView *v) {
+    proof_count = 0;
+    for (uint32_t k = 0; k < v->hdr->n_lines; ++k) {
+        const PcbLine *ln = &v->lines[k];
+        ensure_proof_capacity();
+        ProofLine *pl = &proof[proof_count];
+        pl->line_no = (int)k + 1;
+        pl->formula_str = pcb_formula_str(v, ln->formula);
+        pl->formula_ast = pcb_formula_ast(v, ln->formula);
+        pl->packed.len = 0;
+        pl->just = pcb_just_str(v, ln);
+        pl->rule = (Rule)ln->rule;
+        pl->arg1 = ln->arg1;
+        pl->arg2 = ln->arg2;
+        pl->subst_var = 0;
+        pl->subst_ast = NULL;
+        if (ln->rule == RULE_SUBST) {
+            pl->subst_var = (char)ln->var;
+            pl->subst_ast = pcb_formula_ast(v, (uint32_t)ln->arg1);
+        }
+        proof_count++;
+        if (!pl->formula_str || !pl->just) { out_append("Memory error\n"); return -3; }
+        if (g_store && g_gen) intern_tree(g_store, pl->formula_ast, g_gen);
+    }
+    return 0;
+}
+
+/* Formula table under construction: deduplicates formula strings. */
+typedef struct {
+    char **strs;
+    uint32_t *lens;
+    uint32_t count, cap;
+    uint32_t *slots;      // index + 1, 0 = empty
+    uint32_t nslots;
+    size_t n_symbols;
+} PcbTable;
+
+static uint32_t pcb_hash(const char *s, uint32_t len) {
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < len; ++i) { h ^= (unsigned char)s[i]; h *= 16777619u; }
+    return h;
+}
+
+/* Add a formula (takes ownership of s); returns its index or -1 on error. */
+static int64_t pcb_table_add(PcbTable *t, char *s) {
+    uint32_t len = (uint32_t)strlen(s);
+    uint32_t pos = pcb_hash(s, len) & (t->nslots - 1);
+    while (t->slots[pos]) {
+        uint32_t i = t->slots[pos] - 1;
+        if (t->lens[i] == len && memcmp(t->strs[i], s, len) == 0) { free(s); return i; }
+        pos = (pos + 1) & (t->nslots - 1);
+    }
+    if (t->count == t->cap) { free(s); return -1; }
+    t->strs[t->count] = s;
+    t->lens[t->count] = len;
+    t->slots[pos] = t->count + 1;
+    t->n_symbols += len;
+    return t->count++;
+}
+
+static void pcb_table_free(PcbTable *t) {
+    for (uint32_t i = 0; i < t->count; ++i) free(t->strs[i]);
+    free(t->strs);
+    free(t->lens);
+    free(t->slots);
+}
+
+/* Encode the (parsed and classified) proof array. */
+static int encode_binary_proof(char **out, size_t *out_len) {
+    PcbTable t;
+    memset(&t, 0, sizeof t);
+    t.cap = 2u * (uint32_t)proof_count;
+    t.nslots = 4;
+    while (t.nslots < 2u * t.cap) t.nslots <<= 1;
+    t.strs = (char**)malloc(t.cap * sizeof(char*));
+    t.lens = (uint32_t*)malloc(t.cap * sizeof(uint32_t));
+    t.slots = (uint32_t*)calloc(t.nslots, sizeof(uint32_t));
+    PcbLine *lines = (PcbLine*)calloc((size_t)proof_count, sizeof(PcbLine));
+    if (!t.strs || !t.lens || !t.slots || !lines) { pcb_table_free(&t); free(lines); return -3; }
+
+    int rc = 0;
+    for (int i = 0; i < proof_count && rc == 0; ++i) {
+        ProofLine *pl = &proof[i];
+        classify_justification(pl);
+        if (pl->rule < RULE_PREMISE || pl->rule > RULE_LEMMA) {
+            out_append("Line %d: justification cannot be encoded: \"%s\"\n", pl->line_no, pl->just ? shown(pl->just, 1) : "");
+            rc = -5;
+            break;
+        }
+        /* canonical prefix text, so compressed input is stored expanded */
+        line_ast(i);
+        char *fs = (char*)malloc(tree_size(pl->formula_ast) + 1);
+        if (fs) fs[tree_to_prefix(pl->formula_ast, fs)] = '\0';
+        int64_t f = fs ? pcb_table_add(&t, fs) : -1;
+        if (f < 0) { rc = -3; break; }
+        lines[i].formula = (uint32_t)f;
+        lines[i].rule = (uint8_t)pl->rule;
+        if (pl->rule == RULE_MP) {
+            lines[i].arg1 = pl->arg1;
+            lines[i].arg2 = pl->arg2;
+        } else if (pl->rule == RULE_SUBST) {
+            char *rs = (char*)malloc(tree_size(pl->subst_ast) + 1);
+            if (!rs) { rc = -3; break; }
+            rs[tree_to_prefix(pl->subst_ast, rs)] = '\0';
+            int64_t r = pcb_table_add(&t, rs);
+            if (r < 0) { rc = -3; break; }
+            lines[i].var = (uint8_t)pl->subst_var;
+            lines[i].arg1 = (int32_t)r;
+        }
+    }
+    if (rc == 0) {
+        size_t offs_len = ((size_t)t.count + 1) * sizeof(uint32_t);
+        size_t sym_len = PCB_ALIGN4(t.n_symbols);
+        size_t total = sizeof(PcbHeader) + offs_len + sym_len + (size_t)proof_count * sizeof(PcbLine);
+        char *buf = (char*)calloc(1, total);
+        if (!buf || t.n_symbols > UINT32_MAX) {
+            free(buf);
+            rc = -3;
+        } else {
+            PcbHeader *h = (PcbHeader*)buf;
+            memcpy(h->magic, PCB_MAGIC, 4);
+            h->version = PCB_VERSION;
+            h->n_formulas = t.count;
+            h->n_lines = (uint32_t)proof_count;
+            h->n_symbols = (uint32_t)t.n_symbols;
+            uint32_t *offs = (uint32_t*)(h + 1);
+            char *sym = (char*)(offs + t.count + 1);
+            uint32_t at = 0;
+            for (uint32_t i = 0; i < t.count; ++i) {
+                offs[i] = at;
+                memcpy(sym + at, t.strs[i], t.lens[i]);
+                at += t.lens[i];
+            }
+            offs[t.count] = at;
+            memcpy(sym + sym_len, lines, (size_t)proof_count * sizeof(PcbLine));
+            *out = buf;
+            *out_len = total;
+        }
+    }
+    pcb_table_free(&t);
+    free(lines);
+    return rc;
+}
+
 /* ---------------- Public API: verify_proof and free_output ---------------- */
 
-/*
-  verify_proof:
-    - input: proof text (lines separated by '\n')
-    - output: pointer to malloc'd string with checker messages (set *output)
-    - return: 0 (proof valid), 1 (proof invalid), negative for parse/other errors.
-*/
-int verify_proof(const char *input, char **output) {
+/* Hand the captured messages to the caller (who frees them) and release per-call state. */
+static int finish_call(char **output, int rc) {
+    uint64_t t0 = span_begin();
+    t_call_lines = proof_count;
+    if (t_omitted) {
+        /* the marker itself may exceed the cap by its own few bytes */
+        sb_appendf(g_out, "[report truncated: %zu messages omitted]\n", t_omitted);
+        t_omitted = 0;
+        if (g_stream.cb && !g_stream.stopped) stream_message();
+    }
+    for (int k = 0; k < 2; ++k) sb_free(&t_shown[k]);
+    *output = strdup(g_out->buf ? g_out->buf : "");
+    phase_end(PC_HIST_OUTPUT_NS, "output", t0, "bytes", (long)g_out->len);
+    sb_free(&g_sb);
+    g_out = NULL;
+    cleanup_proof();
+    return rc;
+}
+
+/* Read a text proof into the proof array. Returns 0 or a negative error code. */
+static int read_proof_text(const char *input, size_t len) {
+    int rc = read_proof_from_span(input, len);
+    if (rc != 0) return -200 + rc; // map to negative code
+    return 0;
+}
+
+static int run_verify(const char *input, size_t len, char **output) {
     if (!output) return -100;
     *output = NULL;
     if (!input) return -101;
@@ -543,95 +2532,2031 @@ int verify_proof(const char *input, char **output) {
     if (!sb_init(&g_sb)) return -102;
     g_out = &g_sb;
 
-    // read input via fmemopen
-    size_t len = strlen(input);
-    // fmemopen expects non-const buffer; cast is OK because we won't modify content
-    FILE *fp = fmemopen((void*)input, len, "r");
-    if (!fp) {
-        out_append("Internal error: fmemopen failed\n");
-        char *ret = strdup(g_out->buf);
-        *output = ret;
-        sb_free(&g_sb);
-        g_out = NULL;
-        return -103;
-    }
-
-    int rc = read_proof_from_file(fp);
-    fclose(fp);
+    uint64_t t0 = span_begin();
+    PHASE_HOOK(PC_HIST_TOKENIZE_NS, -1, 0);
+    int rc = read_proof_text(input, len);
+    PHASE_HOOK(PC_HIST_TOKENIZE_NS, -1, 1);
+    phase_end(PC_HIST_TOKENIZE_NS, "tokenize", t0, "bytes", (long)len);
     if (rc != 0) {
-        // error messages were appended by read_proof_from_file
-        char *ret = strdup(g_out->buf);
-        *output = ret;
-        sb_free(&g_sb);
-        g_out = NULL;
-        cleanup_proof();
-        return -200 + rc; // map to negative code
+        // error messages were appended by read_proof_from_span
+        PC_PROBE2(parse__fail, 0, rc);
+        return finish_call(output, rc);
     }
 
     if (proof_count == 0) {
         out_append("No proof lines read.\n");
-        char *ret = strdup(g_out->buf);
-        *output = ret;
-        sb_free(&g_sb);
-        g_out = NULL;
-        cleanup_proof();
-        return -201;
+        return finish_call(output, -201);
     }
 
-    if (!parse_all_formulas()) {
+    t0 = span_begin();
+    PHASE_HOOK(PC_HIST_PARSE_NS, -1, 0);
+    int parsed = parse_all_formulas();
+    PHASE_HOOK(PC_HIST_PARSE_NS, -1, 1);
+    phase_end(PC_HIST_PARSE_NS, "parse", t0, "lines", proof_count);
+    if (!parsed) {
         // parse_all_formulas appended error to outbuf
-        char *ret = strdup(g_out->buf);
-        *output = ret;
-        sb_free(&g_sb);
-        g_out = NULL;
-        cleanup_proof();
-        return -202;
+        return finish_call(output, -202);
     }
 
+    t0 = span_begin();
+    PHASE_HOOK(PC_HIST_CHECK_NS, -1, 0);
     int ok = check_proof(); // appends per-line output
-    // prepare return string (caller will free)
-    char *ret = strdup(g_out->buf ? g_out->buf : "");
-    *output = ret;
-
-    sb_free(&g_sb);
-    g_out = NULL;
-    cleanup_proof();
-    return ok ? 0 : 1;
+    PHASE_HOOK(PC_HIST_CHECK_NS, -1, 1);
+    phase_end(PC_HIST_CHECK_NS, "check", t0, "lines", proof_count);
+    return finish_call(output, ok ? 0 : 1);
 }
 
-void free_output(char *p) {
-    if (p) free(p);
-}
+static int run_verify_binary(const void *buf, size_t len, char **output) {
+    if (!output) return -100;
+    *output = NULL;
+    if (!buf) return -101;
 
-/* Optional standalone program for direct testing
-   Compile with -DBUILD_STANDALONE to include main() in the object.
+    if (!sb_init(&g_sb)) return -102;
+    g_out = &g_sb;
+
+    PcbView v;
+    if (!pcb_open(buf, len, &v)) {
+        out_append("Malformed binary proof\n");
+        return finish_call(output, -210);
+    }
+    uint64_t t0 = span_begin();
+    int rc = load_binary_proof(&v);
+    phase_end(PC_HIST_TOKENIZE_NS, "decode", t0, "bytes", (long)len);
+    if (rc != 0) {
+        PC_PROBE2(parse__fail, 0, -200 + rc);
+        return finish_call(output, -200 + rc);
+    }
+    if (proof_count == 0) {
+        out_append("No proof lines read.\n");
+        return finish_call(output, -201);
+    }
+    t0 = span_begin();
+    int ok = check_proof();
+    phase_end(PC_HIST_CHECK_NS, "check", t0, "lines", proof_count);
+    return finish_call(output, ok ? 0 : 1);
+}
+
+/*
+  verify_proof:
+    - input: proof text (lines separated by '\n')
+    - output: pointer to malloc'd string with checker messages (set *output)
+    - return: 0 (proof valid), 1 (proof invalid), negative for parse/other errors.
+*/
+int verify_proof(const char *input, char **output) {
+    return verify_proof_n(input, input ? strlen(input) : 0, output);
+}
+
+int verify_proof_n(const char *input, size_t len, char **output) {
+    PC_PROBE1(verify__entry, len);
+    alloc_call_begin();
+    t_call_lines = 0;
+    t_omitted = 0;
+    uint64_t t0 = span_begin();
+    FormulaStore *st = g_store;
+    if (st) g_gen = store_enter(st);
+    int rc = run_verify(input, len, output);
+    if (st) {
+        g_gen = 0;
+        store_leave(st);
+    }
+    uint64_t dur = trace_end("verify", t0, "lines", t_call_lines);
+    metrics_call(t0, dur, len, t_call_lines, rc);
+    PC_PROBE2(verify__return, rc, t_call_lines);
+    alloc_call_end();
+    return rc;
+}
+
+int verify_proof_profile(const char *input, size_t len, pc_profile *prof, char **output) {
+    if (prof) {
+        pc_line_cost *top = prof->top;
+        int k = prof->k;
+        memset(prof, 0, sizeof *prof);
+        prof->top = top;
+        prof->k = top && k > 0 ? k : 0;
+    }
+    g_prof = prof;
+    int rc = verify_proof_n(input, len, output);
+    g_prof = NULL;
+    return rc;
+}
+
+int verify_proof_stream(const char *input, size_t len, pc_line_callback cb, void *ctx) {
+    if (!cb) return -100;
+    g_stream.cb = cb;
+    g_stream.ctx = ctx;
+    g_stream.in_line = g_stream.stopped = 0;
+    char *out = NULL;
+    int rc = verify_proof_n(input, len, &out);
+    free(out);
+    if (g_stream.stopped) rc = -230;
+    g_stream.cb = NULL;
+    g_stream.ctx = NULL;
+    return rc;
+}
+
+int verify_proof_binary(const void *buf, size_t len, char **output) {
+    PC_PROBE1(verify__entry, len);
+    alloc_call_begin();
+    t_call_lines = 0;
+    t_omitted = 0;
+    uint64_t t0 = span_begin();
+    FormulaStore *st = g_store;
+    if (st) g_gen = store_enter(st);
+    int rc = run_verify_binary(buf, len, output);
+    if (st) {
+        g_gen = 0;
+        store_leave(st);
+    }
+    uint64_t dur = trace_end("verify", t0, "lines", t_call_lines);
+    metrics_call(t0, dur, len, t_call_lines, rc);
+    PC_PROBE2(verify__return, rc, t_call_lines);
+    alloc_call_end();
+    return rc;
+}
+
+int pc_proof_to_binary(const char *input, char **out, size_t *out_len) {
+    if (!input || !out || !out_len) return -100;
+    *out = NULL;
+    *out_len = 0;
+    int rc = read_proof_text(input, strlen(input));
+    if (rc == 0 && proof_count == 0) rc = -201;
+    if (rc == 0 && !parse_all_formulas()) rc = -202;
+    if (rc == 0) rc = encode_binary_proof(out, out_len);
+    cleanup_proof();
+    return rc;
+}
+
+int pc_compress_proof(const char *input, char **out) {
+    if (!input || !out) return -100;
+    *out = NULL;
+    int rc = read_proof_text(input, strlen(input));
+    if (rc == 0 && proof_count == 0) rc = -201;
+    if (rc == 0 && !parse_all_formulas()) rc = -202;
+    if (rc == 0) {
+        StrBuf sb;
+        if (!sb_init(&sb)) rc = -102;
+        else if (!compress_proof(&sb)) { sb_free(&sb); rc = -3; }
+        else *out = sb.buf;
+    }
+    cleanup_proof();
+    return rc;
+}
+
+int pc_proof_from_binary(const void *buf, size_t len, char **text) {
+    if (!text) return -100;
+    *text = NULL;
+    PcbView v;
+    if (!pcb_open(buf, len, &v)) return -210;
+    StrBuf sb;
+    if (!sb_init(&sb)) return -102;
+    for (uint32_t k = 0; k < v.hdr->n_lines; ++k) {
+        const PcbLine *ln = &v.lines[k];
+        uint32_t a = v.offsets[ln->formula], b = v.offsets[ln->formula + 1];
+        char *just = pcb_just_str(&v, ln);
+        int ok = just && sb_appendf(&sb, "%u %.*s %s\n", k + 1, (int)(b - a), v.symbols + a, just);
+        free(just);
+        if (!ok) { sb_free(&sb); return -3; }
+    }
+    *text = sb.buf;
+    return 0;
+}
+
+/* Parse a standalone formula (premise or goal); NULL if it is not a WFF. */
+static Node *parse_formula_arg(const char *text) {
+    char *fs = strdup(text);
+    if (!fs) return NULL;
+    clean_inplace(fs);
+    Node *n = NULL;
+    if (is_wff_str(fs)) {
+        int idx = 0;
+        n = parse_node(fs, &idx);
+    }
+    free(fs);
+    return n;
+}
+
+int verify_proof_goal(const char *input, const char *const *premises, int n_premises,
+                      const char *goal, char **output) {
+    if (!output) return -100;
+    *output = NULL;
+    if (!input || n_premises < 0 || (n_premises > 0 && !premises)) return -101;
+    alloc_call_begin();   // premises and goal count towards the call
+    Node **asts = (Node**)calloc((size_t)n_premises + 1, sizeof(Node*));
+    Node *goal_ast = NULL;
+    int bad = asts == NULL;
+    for (int k = 0; k < n_premises && !bad; ++k) {
+        asts[k] = premises[k] ? parse_formula_arg(premises[k]) : NULL;
+        if (!asts[k]) bad = 1;
+    }
+    if (!bad && goal) {
+        goal_ast = parse_formula_arg(goal);
+        if (!goal_ast) bad = 1;
+    }
+    int rc;
+    if (bad) {
+        *output = strdup("Premise or goal is not a WFF\n");
+        rc = -220;
+    } else {
+        g_check_premises = premises != NULL;
+        g_premise_asts = asts;
+        g_n_premises = n_premises;
+        g_goal_ast = goal_ast;
+        rc = verify_proof(input, output);
+        g_check_premises = 0;
+        g_premise_asts = NULL;
+        g_n_premises = 0;
+        g_goal_ast = NULL;
+    }
+    for (int k = 0; asts && k < n_premises; ++k) free_tree(asts[k]);
+    free(asts);
+    free_tree(goal_ast);
+    alloc_call_end();
+    return rc;
+}
+
+void free_output(char *p) {
+    if (p) free(p);
+}
+
+/* ---------------- Proof search ---------------- */
+
+/* pc_prove works backwards from the goal. Every formula it meets is interned
+   in a store of its own, so a goal is an id and the search keeps its state
+   per id: open, expanded, proved or failed. A goal reached along several
+   paths is expanded once, and a failure is never retried.
+
+   A goal G is closed at once if it is a premise, an axiom instance or a
+   lemma of the attached store. Otherwise it is expanded into MP options
+   "A and cAG", where the minor formula A comes from
+     - an axiom whose consequent, after one or two antecedents, matches G:
+       the next antecedent, instantiated (AX1: cXY from Y; AX2: ccXYcXZ
+       from cXcYZ, and cXZ from cXB; AX3: cXY from cnYnX);
+     - a premise c H1 c H2 ... c Hk G, which gives Hk;
+     - a subformula of the premises or the goal (this also covers AX1 and
+       AX3 with their unconstrained antecedent);
+   an antecedent variable that G leaves unbound (the B above) ranges over the
+   same subformulas. Both formulas of an option become goals. Open goals are
+   expanded cheapest first: a goal costs the symbols of all formulas still
+   unproved in the partial proof that led to it, plus a step cost per MP
+   step, so a step that trades a goal for smaller ones is followed before
+   detours through larger formulas. A goal is proved when both formulas of
+   one of its options are, and fails when every option has a failed formula;
+   both results are propagated upwards as soon as they are known.
+
+   The forward strategy saturates instead: starting from the premises and
+   the axiom instances over the subformulas, it applies MP to every pair of
+   known formulas, smallest first, until the goal turns up.
+
+   Whatever a search proves goes into a fact table next to the store, with
+   the rule that proved it (and for MP, the two formulas it came from). The
+   first search to prove a formula records it, and a record only cites
+   formulas recorded before it, so the table holds no cycles and the proof
+   is read straight out of it. pc_prove_portfolio runs several searches on
+   one store and fact table: a formula one of them proves closes the same
+   goal in all the others. Failures stay private to a search, since they
+   depend on its size bound. */
+
+#define PROVE_DEFAULT_GOALS 20000
+#define PROVE_DEFAULT_STEP 4        /* in symbols; 1 favours deep chains, 8 and up short proofs */
+#define PROVE_CAPACITY (1u << 20)
+#define PORTFOLIO_CAPACITY (1u << 21)
+
+enum { GOAL_NEW, GOAL_OPEN, GOAL_EXPANDED, GOAL_PROVED, GOAL_FAILED };
+
+/* How a formula was proved. state: 0 = not proved, 1 = being recorded, 2 = recorded. */
+typedef struct {
+    _Atomic uint32_t state;
+    uint32_t rule;        // RULE_PREMISE, RULE_AX1..3, RULE_LEMMA or RULE_MP
+    uint32_t minor, major;
+} ProveFact;
+
+/* The problem and everything proved about it; shared by the searches of a portfolio. */
+typedef struct {
+    FormulaStore st;
+    void *base;
+    ProveFact *facts;
+    uint32_t capacity;
+    uint32_t *premises;   // n_premises premise ids, then the goal
+    int n_premises;
+    uint32_t root;
+    uint32_t *pool;       // subformulas of the premises and the goal, smallest first
+    uint32_t n_pool;
+    uint32_t largest;     // symbols in the largest premise or goal
+} ProveShared;
+
+/* One search's state of a formula. */
+typedef struct {
+    uint32_t size;        // symbols; 0 = not computed yet
+    uint8_t status;       // GOAL_*
+    uint32_t live;        // options not known to fail
+    uint32_t uses;        // options citing it (forwards: implications waiting for it),
+                          // index + 1 into Prover.uses, 0 = none
+    uint32_t ext;         // id in the attached store; 0 = not looked up, UINT32_MAX = absent
+    uint64_t cost;
+} ProveTerm;
+
+typedef struct {
+    uint32_t goal, minor, major;
+    int dead;             // minor or major failed
+} ProveOpt;
+
+typedef struct {
+    uint32_t opt;         // forwards: the waiting implication
+    uint32_t next;        // index + 1, 0 = end
+} ProveUse;
+
+typedef struct {
+    uint64_t cost;
+    uint32_t id;
+} ProveItem;
+
+typedef struct {
+    ProveShared *S;
+    ProveTerm *t;
+    ProveOpt *opts;
+    uint32_t n_opts, cap_opts;
+    ProveUse *uses;
+    uint32_t n_uses, cap_uses;
+    ProveItem *heap;
+    uint32_t n_heap, cap_heap;
+    uint32_t *work;       // propagation worklist, also the emit stack
+    uint32_t n_work, cap_work;
+    unsigned max_size;
+    unsigned step_cost;
+    int largest_first;    // try large subformulas before small ones
+    int full;             // the store or memory ran out
+} Prover;
+
+static int pv_reserve(Prover *P, void **arr, uint32_t *cap, uint32_t need, size_t elem) {
+    if (need <= *cap) return 1;
+    uint32_t nc = *cap ? *cap * 2 : 256;
+    while (nc < need) nc *= 2;
+    void *p = realloc(*arr, (size_t)nc * elem);
+    if (!p) { P->full = 1; return 0; }
+    *arr = p;
+    *cap = nc;
+    return 1;
+}
+
+static uint32_t pv_size(Prover *P, uint32_t id) {
+    ProveTerm *x = &P->t[id];
+    if (!x->size) {
+        const StoreEntry *e = &P->S->st.entries[id];
+        x->size = 1 + (e->kind != 'A' ? pv_size(P, e->left) : 0) + (e->kind == 'C' ? pv_size(P, e->right) : 0);
+    }
+    return x->size;
+}
+
+static uint32_t pv_term(Prover *P, char kind, char atom, uint32_t l, uint32_t r) {
+    uint32_t id = store_intern(&P->S->st, kind, atom, l, r);
+    if (!id) { P->full = 1; return 0; }
+    pv_size(P, id);
+    return id;
+}
+
+static uint32_t pv_imp(Prover *P, uint32_t a, uint32_t b) {
+    return a && b ? pv_term(P, 'C', 0, a, b) : 0;
+}
+
+static uint32_t pv_pool(const Prover *P, uint32_t k) {
+    return P->S->pool[P->largest_first ? P->S->n_pool - 1 - k : k];
+}
+
+/* Record that `id` is proved, unless some search already did. */
+static void pv_record(ProveShared *S, uint32_t id, int rule, uint32_t minor, uint32_t major) {
+    ProveFact *f = &S->facts[id];
+    uint32_t expect = 0;
+    if (!atomic_compare_exchange_strong_explicit(&f->state, &expect, 1,
+                                                 memory_order_acq_rel, memory_order_relaxed))
+        return;
+    f->rule = (uint32_t)rule;
+    f->minor = minor;
+    f->major = major;
+    atomic_store_explicit(&f->state, 2, memory_order_release);
+}
+
+static int pv_known(ProveShared *S, uint32_t id) {
+    return atomic_load_explicit(&S->facts[id].state, memory_order_acquire) != 0;
+}
+
+/* End of the prefix-notation formula starting at s. */
+static const char *prefix_end(const char *s) {
+    for (int need = 1; need; ++s) need += *s == 'c' ? 1 : *s == 'n' ? 0 : -1;
+    return s;
+}
+
+/* Match formula `id` against the schema at pat, extending bind.
+   Returns the end of the schema, or NULL if it does not match. */
+static const char *pv_match(Prover *P, const char *pat, uint32_t id, uint32_t *bind) {
+    const StoreEntry *e = &P->S->st.entries[id];
+    if (*pat == 'c' || *pat == 'n') {
+        if (e->kind != (*pat == 'c' ? 'C' : 'N')) return NULL;
+        pat = pv_match(P, pat + 1, e->left, bind);
+        return pat && e->kind == 'C' ? pv_match(P, pat, e->right, bind) : pat;
+    }
+    uint32_t *v = &bind[*pat - 'A'];
+    if (*v && *v != id) return NULL;
+    *v = id;
+    return pat + 1;
+}
+
+/* Instantiate the schema at *pat (advancing it); 0 if a variable is unbound. */
+static uint32_t pv_inst(Prover *P, const char **pat, const uint32_t *bind) {
+    char ch = *(*pat)++;
+    if (ch == 'c') {
+        uint32_t l = pv_inst(P, pat, bind);
+        uint32_t r = pv_inst(P, pat, bind);
+        return pv_imp(P, l, r);
+    }
+    if (ch == 'n') {
+        uint32_t l = pv_inst(P, pat, bind);
+        return l ? pv_term(P, 'N', 0, l, 0) : 0;
+    }
+    return bind[ch - 'A'];
+}
+
+/* Id of formula `id` in the attached store, or 0 if it was never interned there. */
+static uint32_t pv_ext(Prover *P, uint32_t id) {
+    ProveTerm *x = &P->t[id];
+    if (!x->ext) {
+        const StoreEntry *e = &P->S->st.entries[id];
+        uint32_t l = 0, r = 0, found = 0;
+        if (e->kind == 'N' || e->kind == 'C') l = pv_ext(P, e->left);
+        if (e->kind == 'C' && l) r = pv_ext(P, e->right);
+        if (e->kind == 'A' || (l && (e->kind == 'N' || r)))
+            found = store_lookup(g_store, (char)e->kind, (char)e->atom, l, r);
+        x->ext = found ? found : UINT32_MAX;
+    }
+    return x->ext == UINT32_MAX ? 0 : x->ext;
+}
+
+/* Rule that proves `id` outright, or RULE_UNPARSED if it needs a search. */
+static int pv_leaf_rule(Prover *P, uint32_t id) {
+    for (int k = 0; k < P->S->n_premises; ++k)
+        if (P->S->premises[k] == id) return RULE_PREMISE;
+    const char *pats[3] = { AX1_PAT, AX2_PAT, AX3_PAT };
+    for (int k = 0; k < 3; ++k) {
+        uint32_t bind[26] = { 0 };
+        const char *end = pv_match(P, pats[k], id, bind);
+        if (end && !*end) return RULE_AX1 + k;
+    }
+    if (g_store && store_is_lemma(g_store, pv_ext(P, id))) return RULE_LEMMA;
+    return RULE_UNPARSED;
+}
+
+static void pv_push(Prover *P, uint32_t id, uint64_t cost) {
+    if (!pv_reserve(P, (void**)&P->heap, &P->cap_heap, P->n_heap + 1, sizeof(ProveItem))) return;
+    uint32_t k = P->n_heap++;
+    while (k > 0 && P->heap[(k - 1) / 2].cost > cost) {
+        P->heap[k] = P->heap[(k - 1) / 2];
+        k = (k - 1) / 2;
+    }
+    P->heap[k] = (ProveItem){ cost, id };
+}
+
+static ProveItem pv_pop(Prover *P) {
+    ProveItem top = P->heap[0], last = P->heap[--P->n_heap];
+    uint32_t k = 0;
+    for (;;) {
+        uint32_t c = 2 * k + 1;
+        if (c >= P->n_heap) break;
+        if (c + 1 < P->n_heap && P->heap[c + 1].cost < P->heap[c].cost) c++;
+        if (P->heap[c].cost >= last.cost) break;
+        P->heap[k] = P->heap[c];
+        k = c;
+    }
+    if (P->n_heap) P->heap[k] = last;
+    return top;
+}
+
+/* First sight of a goal: close it if it is a leaf or already proved. */
+static void pv_classify(Prover *P, uint32_t id) {
+    ProveTerm *x = &P->t[id];
+    if (x->status != GOAL_NEW) return;
+    if (!pv_known(P->S, id)) {
+        int rule = pv_leaf_rule(P, id);
+        if (rule == RULE_UNPARSED) return;
+        pv_record(P->S, id, rule, 0, 0);
+    }
+    x->status = GOAL_PROVED;
+}
+
+/* Queue an open goal, or requeue it if it was reached more cheaply. */
+static void pv_goal(Prover *P, uint32_t id, uint64_t cost) {
+    ProveTerm *x = &P->t[id];
+    pv_classify(P, id);
+    if (x->status == GOAL_NEW) {
+        x->status = GOAL_OPEN;
+        x->cost = cost;
+        pv_push(P, id, cost);
+    } else if (x->status == GOAL_OPEN && cost < x->cost) {
+        x->cost = cost;
+        pv_push(P, id, cost);
+    }
+}
+
+/* Goal `id` was just proved or failed: settle every goal that depends on it. */
+static void pv_settle(Prover *P, uint32_t id) {
+    P->n_work = 0;
+    if (!pv_reserve(P, (void**)&P->work, &P->cap_work, 1, sizeof(uint32_t))) return;
+    P->work[P->n_work++] = id;
+    while (P->n_work) {
+        uint32_t x = P->work[--P->n_work];
+        int proved = P->t[x].status == GOAL_PROVED;
+        for (uint32_t u = P->t[x].uses; u; u = P->uses[u - 1].next) {
+            ProveOpt *o = &P->opts[P->uses[u - 1].opt];
+            ProveTerm *g = &P->t[o->goal];
+            if (o->dead || g->status != GOAL_EXPANDED) continue;
+            if (proved) {
+                if (P->t[o->minor].status != GOAL_PROVED || P->t[o->major].status != GOAL_PROVED) continue;
+                g->status = GOAL_PROVED;
+                pv_record(P->S, o->goal, RULE_MP, o->minor, o->major);
+            } else {
+                o->dead = 1;
+                if (--g->live) continue;
+                g->status = GOAL_FAILED;
+            }
+            if (!pv_reserve(P, (void**)&P->work, &P->cap_work, P->n_work + 1, sizeof(uint32_t))) return;
+            P->work[P->n_work++] = o->goal;
+        }
+    }
+}
+
+static void pv_use(Prover *P, uint32_t id, uint32_t opt) {
+    if (!pv_reserve(P, (void**)&P->uses, &P->cap_uses, P->n_uses + 1, sizeof(ProveUse))) return;
+    P->uses[P->n_uses] = (ProveUse){ opt, P->t[id].uses };
+    P->t[id].uses = ++P->n_uses;
+}
+
+/* Add the option "a and c a g" to goal g, which is being expanded. */
+static void pv_option(Prover *P, uint32_t g, uint32_t a) {
+    ProveTerm *G = &P->t[g];
+    if (!a || a == g || G->status != GOAL_EXPANDED) return;
+    if (P->t[a].size + G->size + 1 > P->max_size) return;
+    uint32_t b = pv_imp(P, a, g);
+    if (!b) return;
+    ProveTerm *A = &P->t[a], *B = &P->t[b];
+    pv_classify(P, a);
+    pv_classify(P, b);
+    if (A->status == GOAL_FAILED || B->status == GOAL_FAILED) return;
+    if (A->status == GOAL_PROVED && B->status == GOAL_PROVED) {
+        G->status = GOAL_PROVED;
+        pv_record(P->S, g, RULE_MP, a, b);
+        pv_settle(P, g);
+        return;
+    }
+    if (!pv_reserve(P, (void**)&P->opts, &P->cap_opts, P->n_opts + 1, sizeof(ProveOpt))) return;
+    uint32_t o = P->n_opts++;
+    P->opts[o] = (ProveOpt){ g, a, b, 0 };
+    G->live++;
+    uint64_t cost = G->cost - G->size + P->step_cost;
+    if (A->status != GOAL_PROVED) cost += A->size;
+    if (B->status != GOAL_PROVED) cost += B->size;
+    if (A->status != GOAL_PROVED) { pv_use(P, a, o); pv_goal(P, a, cost); }
+    if (B->status != GOAL_PROVED) { pv_use(P, b, o); pv_goal(P, b, cost); }
+}
+
+/* Options whose minor formula is the axiom antecedent at hyp under bind. A
+   bare unbound variable is skipped (the subformula options cover it); one
+   other unbound variable ranges over the pool. */
+static void pv_hyp_options(Prover *P, uint32_t g, const char *hyp, uint32_t *bind) {
+    const char *end = prefix_end(hyp);
+    int free_var = -1;
+    for (const char *q = hyp; q < end; ++q) {
+        if (!isupper((unsigned char)*q) || bind[*q - 'A']) continue;
+        if (free_var >= 0 && free_var != *q - 'A') return;
+        free_var = *q - 'A';
+    }
+    const char *q = hyp;
+    if (free_var < 0) {
+        pv_option(P, g, pv_inst(P, &q, bind));
+        return;
+    }
+    if (end == hyp + 1) return;
+    for (uint32_t k = 0; k < P->S->n_pool; ++k) {
+        bind[free_var] = pv_pool(P, k);
+        q = hyp;
+        pv_option(P, g, pv_inst(P, &q, bind));
+    }
+    bind[free_var] = 0;
+}
+
+static void pv_expand(Prover *P, uint32_t g) {
+    const StoreEntry *e = P->S->st.entries;
+    P->t[g].status = GOAL_EXPANDED;
+    const char *pats[3] = { AX1_PAT, AX2_PAT, AX3_PAT };
+    for (int k = 0; k < 3; ++k) {
+        /* the axiom is c H1 T1 with T1 = c H2 T2 ...; try T1 and T2 */
+        const char *hyp = pats[k] + 1, *t = prefix_end(hyp);
+        for (int j = 0; j < 2; ++j) {
+            uint32_t bind[26] = { 0 };
+            if (pv_match(P, t, g, bind)) pv_hyp_options(P, g, hyp, bind);
+            if (*t != 'c') break;
+            hyp = t + 1;
+            t = prefix_end(hyp);
+        }
+    }
+    for (int k = 0; k < P->S->n_premises; ++k) {
+        for (uint32_t x = P->S->premises[k]; e[x].kind == 'C'; x = e[x].right)
+            if (e[x].right == g) pv_option(P, g, e[x].left);
+    }
+    for (uint32_t k = 0; k < P->S->n_pool; ++k) pv_option(P, g, pv_pool(P, k));
+    if (P->t[g].status == GOAL_EXPANDED && P->t[g].live == 0) {
+        P->t[g].status = GOAL_FAILED;
+        pv_settle(P, g);
+    }
+}
+
+/* Searching forwards: a newly derived formula joins the queue. */
+static void pv_derive(Prover *P, uint32_t id, int rule, uint32_t minor, uint32_t major) {
+    if (!id) return;
+    ProveTerm *x = &P->t[id];
+    if (x->status != GOAL_NEW || pv_size(P, id) > P->max_size) return;
+    pv_record(P->S, id, rule, minor, major);
+    x->status = GOAL_OPEN;
+    x->cost = x->size;
+    pv_push(P, id, x->cost);
+}
+
+/* Queue the premises and the axiom instances over the first m subformulas,
+   m as large as keeps each schema within `max` instances. */
+static void pv_seed(Prover *P, unsigned long max) {
+    for (int k = 0; k < P->S->n_premises; ++k) pv_derive(P, P->S->premises[k], RULE_PREMISE, 0, 0);
+    const char *pats[3] = { AX1_PAT, AX2_PAT, AX3_PAT };
+    for (int k = 0; k < 3; ++k) {
+        char vars[26];
+        int nv = 0;
+        for (const char *q = pats[k]; *q; ++q)
+            if (isupper((unsigned char)*q) && !memchr(vars, *q, (size_t)nv)) vars[nv++] = *q;
+        uint32_t m = P->S->n_pool;
+        for (;;) {
+            unsigned long n = 1;
+            for (int v = 0; v < nv; ++v) n *= m;
+            if (m <= 1 || n <= max) break;
+            m--;
+        }
+        uint32_t idx[26] = { 0 }, bind[26] = { 0 };
+        for (;;) {
+            for (int v = 0; v < nv; ++v) bind[vars[v] - 'A'] = pv_pool(P, idx[v]);
+            const char *q = pats[k];
+            pv_derive(P, pv_inst(P, &q, bind), RULE_AX1 + k, 0, 0);
+            int v = 0;
+            while (v < nv && ++idx[v] == m) idx[v++] = 0;
+            if (v == nv || P->full) break;
+        }
+    }
+}
+
+/* Searching forwards: MP between `x` and every known formula it fits. */
+static void pv_forward_step(Prover *P, uint32_t x) {
+    const StoreEntry *e = P->S->st.entries;
+    P->t[x].status = GOAL_PROVED;
+    if (e[x].kind == 'C') {
+        if (P->t[e[x].left].status == GOAL_PROVED) pv_derive(P, e[x].right, RULE_MP, e[x].left, x);
+        else pv_use(P, e[x].left, x);
+    }
+    for (uint32_t u = P->t[x].uses; u; u = P->uses[u - 1].next) {
+        uint32_t imp = P->uses[u - 1].opt;
+        pv_derive(P, e[imp].right, RULE_MP, x, imp);
+    }
+}
+
+/* Run one search until the goal is proved (by any search sharing P->S), the
+   search is exhausted, `max_goals` goals were expanded or *cancel is set.
+   Returns the number of goals expanded. */
+static unsigned long pv_search(Prover *P, int forward, unsigned long max_goals, _Atomic int *cancel) {
+    ProveShared *S = P->S;
+    uint32_t root = S->root;
+    unsigned long expanded = 0;
+    if (forward) pv_seed(P, max_goals);
+    else pv_goal(P, root, pv_size(P, root));
+    while (!pv_known(S, root) && P->t[root].status != GOAL_FAILED
+           && P->n_heap && expanded < max_goals && !P->full) {
+        if (cancel && atomic_load_explicit(cancel, memory_order_relaxed)) break;
+        ProveItem it = pv_pop(P);
+        ProveTerm *x = &P->t[it.id];
+        if (x->status != GOAL_OPEN || it.cost != x->cost) continue;
+        expanded++;
+        if (forward) {
+            pv_forward_step(P, it.id);
+        } else if (pv_known(S, it.id)) {
+            /* another search proved it meanwhile */
+            x->status = GOAL_PROVED;
+            pv_settle(P, it.id);
+        } else {
+            pv_expand(P, it.id);
+        }
+    }
+    return expanded;
+}
+
+static void pv_write(const ProveShared *S, uint32_t id, char **out) {
+    const StoreEntry *e = &S->st.entries[id];
+    if (e->kind == 'A') { *(*out)++ = (char)e->atom; return; }
+    *(*out)++ = e->kind == 'N' ? 'n' : 'c';
+    pv_write(S, e->left, out);
+    if (e->kind == 'C') pv_write(S, e->right, out);
+}
+
+static ProveFact pv_fact(ProveShared *S, uint32_t id) {
+    ProveFact *f = &S->facts[id];
+    while (atomic_load_explicit(&f->state, memory_order_acquire) != 2) ;   // another search is recording it
+    ProveFact copy = { 2, f->rule, f->minor, f->major };
+    return copy;
+}
+
+/* Write the proof of `root` in the checker's line format, every formula
+   before the lines that cite it. */
+static int pv_emit(Prover *P, uint32_t root, StrBuf *sb) {
+    ProveShared *S = P->S;
+    uint32_t *line = (uint32_t*)calloc(S->capacity, sizeof(uint32_t));
+    if (!line) return 0;
+    uint32_t next = 1;
+    int ok = 1;
+    P->n_work = 0;
+    if (pv_reserve(P, (void**)&P->work, &P->cap_work, 1, sizeof(uint32_t))) P->work[P->n_work++] = root;
+    else ok = 0;
+    while (ok && P->n_work) {
+        uint32_t id = P->work[P->n_work - 1];
+        if (line[id]) { P->n_work--; continue; }
+        ProveFact f = pv_fact(S, id);
+        if (f.rule == RULE_MP && (!line[f.minor] || !line[f.major])) {
+            ok = pv_reserve(P, (void**)&P->work, &P->cap_work, P->n_work + 2, sizeof(uint32_t));
+            if (ok && !line[f.major]) P->work[P->n_work++] = f.major;
+            if (ok && !line[f.minor]) P->work[P->n_work++] = f.minor;
+            continue;
+        }
+        P->n_work--;
+        line[id] = next++;
+        uint32_t size = pv_size(P, id);
+        ok = sb_appendf(sb, "%u ", line[id]) && sb_grow_to(sb, sb->len + size + 1);
+        if (!ok) break;
+        char *w = sb->buf + sb->len;
+        pv_write(S, id, &w);
+        sb->len += size;
+        sb->buf[sb->len] = '\0';
+        ok = f.rule == RULE_MP ? sb_appendf(sb, " MP %u %u\n", line[f.minor], line[f.major])
+                               : sb_appendf(sb, " %s\n", RULE_NAMES[f.rule]);
+    }
+    free(line);
+    return ok;
+}
+
+static uint32_t sh_node(ProveShared *S, const Node *n) {
+    if (n->kind == 'A') return store_intern(&S->st, 'A', n->atom, 0, 0);
+    uint32_t l = sh_node(S, n->left);
+    if (!l) return 0;
+    if (n->kind == 'N') return store_intern(&S->st, 'N', 0, l, 0);
+    uint32_t r = sh_node(S, n->right);
+    return r ? store_intern(&S->st, 'C', 0, l, r) : 0;
+}
+
+static uint32_t sh_size(const ProveShared *S, uint32_t *sz, uint32_t id) {
+    if (!sz[id]) {
+        const StoreEntry *e = &S->st.entries[id];
+        sz[id] = 1 + (e->kind != 'A' ? sh_size(S, sz, e->left) : 0) + (e->kind == 'C' ? sh_size(S, sz, e->right) : 0);
+    }
+    return sz[id];
+}
+
+static void sh_collect(ProveShared *S, unsigned char *seen, uint32_t id) {
+    if (seen[id]) return;
+    seen[id] = 1;
+    S->pool[S->n_pool++] = id;
+    const StoreEntry *e = &S->st.entries[id];
+    if (e->kind != 'A') sh_collect(S, seen, e->left);
+    if (e->kind == 'C') sh_collect(S, seen, e->right);
+}
+
+static _Thread_local const uint32_t *t_pool_size;
+
+static int cmp_pool(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    uint32_t sx = t_pool_size[x], sy = t_pool_size[y];
+    return sx != sy ? (sx < sy ? -1 : 1) : (x < y ? -1 : x > y);
+}
+
+static void pv_shared_free(ProveShared *S) {
+    free(S->base);
+    free(S->facts);
+    free(S->premises);
+    free(S->pool);
+}
+
+/* Intern the premises and goal and collect the subformula pool.
+   Returns 0, -220 if a formula is not a WFF or -102 if memory ran out. */
+static int pv_shared_init(ProveShared *S, const char *const *premises, int n_premises,
+                          const char *goal, uint32_t capacity) {
+    memset(S, 0, sizeof *S);
+    uint32_t nslots = 2 * capacity;
+    size_t size = store_layout(capacity, nslots);
+    S->base = calloc(1, size);
+    S->facts = (ProveFact*)calloc(capacity, sizeof(ProveFact));
+    S->premises = (uint32_t*)calloc((size_t)n_premises + 1, sizeof(uint32_t));
+    if (!S->base || !S->facts || !S->premises) return -102;
+    S->capacity = capacity;
+    store_init_header((StoreHeader*)S->base, capacity, nslots, size);
+    store_bind(&S->st, S->base, size, 0);
+    for (int k = 0; k <= n_premises; ++k) {
+        Node *n = parse_formula_arg(k < n_premises ? premises[k] : goal);
+        if (!n) return -220;
+        S->premises[k] = sh_node(S, n);
+        free_tree(n);
+        if (!S->premises[k]) return -102;
+    }
+    S->n_premises = n_premises;
+    S->root = S->premises[n_premises];
+
+    uint32_t count = atomic_load(&S->st.hdr->count);
+    uint32_t *sz = (uint32_t*)calloc(count, sizeof(uint32_t));
+    unsigned char *seen = (unsigned char*)calloc(count, 1);
+    S->pool = (uint32_t*)malloc(count * sizeof(uint32_t));
+    int rc = sz && seen && S->pool ? 0 : -102;
+    for (int k = 0; rc == 0 && k <= n_premises; ++k) {
+        uint32_t s = sh_size(S, sz, S->premises[k]);
+        if (s > S->largest) S->largest = s;
+        sh_collect(S, seen, S->premises[k]);
+    }
+    if (rc == 0) {
+        t_pool_size = sz;
+        qsort(S->pool, S->n_pool, sizeof(uint32_t), cmp_pool);
+        t_pool_size = NULL;
+    }
+    free(sz);
+    free(seen);
+    return rc;
+}
+
+/* Run the search `o` describes on S. Returns 0 with the proof in *proof,
+   1 if none was found, -102 if memory or the store ran out. */
+static int pv_run(ProveShared *S, const pc_prove_options *o, _Atomic int *cancel,
+                  char **proof, unsigned long *expanded) {
+    Prover P;
+    memset(&P, 0, sizeof P);
+    P.S = S;
+    P.t = (ProveTerm*)calloc(S->capacity, sizeof(ProveTerm));
+    if (!P.t) return -102;
+    P.max_size = o->max_size ? o->max_size : 4 * S->largest + 16;
+    P.step_cost = o->step_cost ? o->step_cost : PROVE_DEFAULT_STEP;
+    P.largest_first = o->largest_first;
+
+    uint64_t t0 = trace_begin();
+    FormulaStore *st = g_store;
+    if (st) store_enter(st);   // lemma lookups hold ids of the attached store
+    *expanded = pv_search(&P, o->forward, o->max_goals ? o->max_goals : PROVE_DEFAULT_GOALS, cancel);
+    if (st) store_leave(st);
+    trace_end(o->forward ? "prove forward" : "prove", t0, "goals", (long)*expanded);
+
+    int rc = P.full ? -102 : 1;
+    if (pv_known(S, S->root)) {
+        StrBuf sb;
+        if (!sb_init(&sb)) rc = -102;
+        else if (!pv_emit(&P, S->root, &sb)) { sb_free(&sb); rc = -102; }
+        else { *proof = sb.buf; rc = 0; }
+    }
+    free(P.t);
+    free(P.opts);
+    free(P.uses);
+    free(P.heap);
+    free(P.work);
+    return rc;
+}
+
+int pc_prove(const char *const *premises, int n_premises, const char *goal,
+             pc_prove_options *opts, char **proof) {
+    if (!proof) return -100;
+    *proof = NULL;
+    if (!goal || n_premises < 0 || (n_premises > 0 && !premises)) return -101;
+    pc_prove_options o = { 0 };
+    if (opts) o = *opts;
+    unsigned long expanded = 0;
+    ProveShared S;
+    int rc = pv_shared_init(&S, premises, n_premises, goal, PROVE_CAPACITY);
+    if (rc == 0) rc = pv_run(&S, &o, NULL, proof, &expanded);
+    pv_shared_free(&S);
+    if (opts) {
+        opts->expanded = expanded;
+        opts->strategy = rc == 0 ? 0 : -1;
+    }
+    return rc;
+}
+
+/* Strategies of pc_prove_portfolio, in the order threads are given them;
+   the first is pc_prove's default. max_size is taken as a multiplier of
+   the largest premise or goal, plus 4 x that multiplier. */
+static const pc_prove_options PORTFOLIO[] = {
+    { .step_cost = 4, .max_size = 4 },
+    { .forward = 1, .max_size = 2 },
+    { .step_cost = 1, .max_size = 4 },
+    { .step_cost = 16, .max_size = 2 },
+    { .step_cost = 4, .max_size = 8, .largest_first = 1 },
+    { .forward = 1, .max_size = 4, .largest_first = 1 },
+    { .step_cost = 8, .max_size = 4, .largest_first = 1 },
+    { .step_cost = 2, .max_size = 8 },
+};
+#define PORTFOLIO_STRATEGIES ((int)(sizeof PORTFOLIO / sizeof PORTFOLIO[0]))
+
+typedef struct {
+    ProveShared *S;
+    pc_prove_options opts;
+    int index;
+    const char *const *premises;
+    int n_premises;
+    const char *goal;
+    _Atomic int *winner;  // index of the first strategy whose proof checked; -1 until then
+    _Atomic int *cancel;
+    int rc;
+    unsigned long expanded;
+    char *proof;          // the winner's proof
+} PortfolioJob;
+
+static void *portfolio_worker(void *arg) {
+    PortfolioJob *job = (PortfolioJob*)arg;
+    char *proof = NULL;
+    job->rc = pv_run(job->S, &job->opts, job->cancel, &proof, &job->expanded);
+    if (job->rc == 0 && !atomic_load(job->cancel)) {
+        char *out = NULL;
+        int ok = verify_proof_goal(proof, job->premises, job->n_premises, job->goal, &out) == 0;
+        free(out);
+        int none = -1;
+        if (ok && atomic_compare_exchange_strong(job->winner, &none, job->index)) {
+            atomic_store(job->cancel, 1);
+            job->proof = proof;
+            proof = NULL;
+        }
+    }
+    free(proof);
+    return NULL;
+}
+
+int pc_prove_portfolio(const char *const *premises, int n_premises, const char *goal,
+                       int threads, pc_prove_options *opts, char **proof) {
+    static const char *const no_premises[1] = { NULL };
+    if (!proof) return -100;
+    *proof = NULL;
+    if (!goal || n_premises < 0 || (n_premises > 0 && !premises)) return -101;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > PORTFOLIO_STRATEGIES) threads = PORTFOLIO_STRATEGIES;
+
+    ProveShared S;
+    int rc = pv_shared_init(&S, premises, n_premises, goal, PORTFOLIO_CAPACITY);
+    if (rc != 0) {
+        pv_shared_free(&S);
+        return rc;
+    }
+    _Atomic int winner = -1, cancel = 0;
+    PortfolioJob jobs[PORTFOLIO_STRATEGIES];
+    pthread_t tids[PORTFOLIO_STRATEGIES];
+    int started[PORTFOLIO_STRATEGIES];
+    for (int k = 0; k < threads; ++k) {
+        PortfolioJob *job = &jobs[k];
+        memset(job, 0, sizeof *job);
+        job->S = &S;
+        job->opts = PORTFOLIO[k];
+        job->opts.max_size = opts && opts->max_size ? opts->max_size
+                           : PORTFOLIO[k].max_size * (S.largest + 4);
+        job->opts.max_goals = opts ? opts->max_goals : 0;
+        job->index = k;
+        job->premises = n_premises > 0 ? premises : no_premises;
+        job->n_premises = n_premises;
+        job->goal = goal;
+        job->winner = &winner;
+        job->cancel = &cancel;
+        started[k] = k > 0 && pthread_create(&tids[k], NULL, portfolio_worker, job) == 0;
+    }
+    /* the calling thread runs the first strategy, and any that could not get a thread */
+    for (int k = 0; k < threads; ++k)
+        if (!started[k]) portfolio_worker(&jobs[k]);
+    unsigned long expanded = 0;
+    int full = 1;
+    for (int k = 0; k < threads; ++k) {
+        if (started[k]) pthread_join(tids[k], NULL);
+        expanded += jobs[k].expanded;
+        if (jobs[k].rc != -102) full = 0;
+    }
+    int w = atomic_load(&winner);
+    if (w >= 0) {
+        *proof = jobs[w].proof;
+        rc = 0;
+    } else {
+        rc = full ? -102 : 1;
+    }
+    if (opts) {
+        opts->expanded = expanded;
+        opts->strategy = w;
+    }
+    pv_shared_free(&S);
+    return rc;
+}
+
+/* Optional standalone program for direct testing
+   Compile with -DBUILD_STANDALONE to include main() in the object.
+
+   Usage: proof_checker [--binary | --to-binary | --from-binary | --compress | --profile | --stream] [FILE...]
+     (default)      verify a text proof (plain or compressed)
+     --stream       verify a text proof and write each line's verdict as a
+                    JSON line as soon as it is checked
+     --profile      verify a text proof and print the cost per rule and the
+                    ten most expensive lines to stderr
+     --binary       verify a binary proof
+     --to-binary    convert a text proof to the binary format on stdout
+     --from-binary  convert a binary proof to text on stdout
+     --compress     rewrite a text proof with back-references on stdout
+   Files are mmap'd and handed to the checker as spans; without FILE
+   arguments stdin is used (mmap'd if it is a regular file, read otherwise).
+   Any other --option prints the usage and exits with status 2.
+
+   Batch mode: proof_checker --batch [--jobs N] [--completion-order] [--flush] [FILE]
+     reads JSONL records {id, premises, goal, proof} (from FILE or stdin;
+     a record with a goal and no premises may use no Premise lines),
+     verifies them on N threads and writes one JSON result per line, in
+     input order unless --completion-order is given. --flush writes each
+     result as soon as it is ready, so a supervisor that sees the process
+     die knows exactly which records finished (see shard_runner.py).
+     --trace FILE (batch and directory mode) records tokenize, parse,
+     per-rule check and output spans of every proof and writes them to
+     FILE as Chrome trace-event JSON when the run ends. --metrics prints
+     a JSON summary of the latency, size and return-code metrics to stderr
+     (and the allocation sites, when built with -DPC_ALLOC_PROFILE).
+     --max-text N and --max-report N bound the "output" of each record (see
+     pc_report_limits).
+
+   Proof search: proof_checker --prove [--max-goals N] [--max-size N] [--threads N] GOAL [PREMISE...]
+     searches for a proof of GOAL with pc_prove and prints it in the line
+     format (exit status 0), or reports that none was found (status 1).
+     A GOAL or PREMISE that is not a WFF, a bad option or running out of
+     memory gives status 2.
+     --threads N runs pc_prove_portfolio instead (0 = one thread per CPU).
+
+   Directory mode: proof_checker --dir DIR [--jobs N] [--completion-order] [--no-uring]
+     verifies every regular file under DIR (one text proof per file) with
+     the same worker pool and JSONL output, the id being the file path.
+     Files are loaded with io_uring when available.
 */
 #ifdef BUILD_STANDALONE
-int main(void) {
-    // read entire stdin into a string
-    size_t cap = 8192, len = 0;
+#include <errno.h>
+#include <ftw.h>
+#include <time.h>
+
+typedef struct {
+    const char *data;
+    size_t len;
+    void *map;            // mmap'd region (or NULL)
+    char *owned;          // heap buffer for pipes (or NULL)
+} InputSpan;
+
+/* Read a non-seekable descriptor into a heap buffer. */
+static int read_fd_buffered(int fd, InputSpan *in) {
+    size_t cap = 1 << 16, len = 0;
     char *buf = malloc(cap);
-    if (!buf) { perror("malloc"); return 2; }
-    int c;
-    while ((c = getchar()) != EOF) {
-        if (len + 2 >= cap) {
-            cap *= 2;
-            char *nb = realloc(buf, cap);
-            if (!nb) { perror("realloc"); free(buf); return 2; }
+    if (!buf) return -1;
+    for (;;) {
+        if (len == cap) {
+            char *nb = realloc(buf, cap * 2);
+            if (!nb) { free(buf); return -1; }
             buf = nb;
+            cap *= 2;
+        }
+        ssize_t r = read(fd, buf + len, cap - len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) { free(buf); return -1; }
+        if (r == 0) break;
+        len += (size_t)r;
+    }
+    in->data = in->owned = buf;
+    in->len = len;
+    return 0;
+}
+
+/* Open `path` (NULL = stdin) as a span: mmap regular files, buffer the rest. */
+static int open_input(const char *path, InputSpan *in) {
+    memset(in, 0, sizeof *in);
+    int fd = path ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0) return -1;
+    struct stat sb;
+    int rc = 0;
+    if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+        void *m = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            madvise(m, (size_t)sb.st_size, MADV_SEQUENTIAL);
+            in->map = m;
+            in->data = (const char*)m;
+            in->len = (size_t)sb.st_size;
+        } else {
+            rc = read_fd_buffered(fd, in);
+        }
+    } else {
+        rc = read_fd_buffered(fd, in);
+    }
+    if (path) close(fd);
+    return rc;
+}
+
+static void close_input(InputSpan *in) {
+    if (in->map) munmap(in->map, in->len);
+    free(in->owned);
+    memset(in, 0, sizeof *in);
+}
+
+/* ---------------- JSONL batch mode ---------------- */
+
+/* Each input line is a record {"id": ..., "premises": [...], "goal": "...",
+   "proof": "..."}; each output line is {"id": ..., "rc": N, "valid": bool,
+   "us": elapsed microseconds, "output": "..."}. Records are verified by
+   `jobs` worker threads. At most `window` records are in flight (queued,
+   being checked, or waiting to be written), so the reader blocks when the
+   workers fall behind and memory stays bounded however long the stream is. */
+
+typedef struct BatchJob {
+    long seq;
+    char *id;             // raw JSON text of the id value ("null" if absent)
+    char **premises;      // NULL if the record has no "premises"
+    int n_premises;
+    char *goal;
+    char *proof;
+    int malformed;
+    char *path;           // file to read in the worker (thread-pool I/O)
+    int io_error;         // errno from loading the file, 0 if none
+    char *result;         // formatted output line
+    struct BatchJob *next;
+} BatchJob;
+
+typedef struct {
+    pthread_mutex_t mu;
+    pthread_cond_t can_read;      // in-flight count dropped below window
+    pthread_cond_t have_work;
+    BatchJob *head, *tail;        // queue of unverified jobs
+    BatchJob **ready;             // completed jobs by seq % window (input order)
+    long next_write;
+    int in_flight;
+    int window;
+    int ordered;
+    int eof;
+    FILE *out;
+    int jobs;
+    pthread_t *threads;
+    long next_seq;
+} BatchState;
+
+static const char *json_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    return p;
+}
+
+/* Four hex digits of a \u escape at p; -1 if they are not hex. */
+static long json_hex4(const char *p) {
+    long v = 0;
+    for (int k = 0; k < 4; ++k, ++p) {
+        if (!isxdigit((unsigned char)*p)) return -1;
+        v = v * 16 + (isdigit((unsigned char)*p) ? *p - '0' : (tolower((unsigned char)*p) - 'a' + 10));
+    }
+    return v;
+}
+
+/* Parse a JSON string at p (which points at the opening quote) into a
+   malloc'd UTF-8 C string; returns the position after it or NULL.  A \u0000
+   (which would cut the C string short) and unpaired surrogates are
+   rejected; a surrogate pair becomes one 4-byte sequence. */
+static const char *json_string(const char *p, char **out) {
+    if (*p != '"') return NULL;
+    p++;
+    size_t cap = 64, len = 0;
+    char *s = malloc(cap);
+    if (!s) return NULL;
+    while (*p && *p != '"') {
+        if (len + 5 >= cap) {
+            char *ns = realloc(s, cap *= 2);
+            if (!ns) { free(s); return NULL; }
+            s = ns;
+        }
+        char c = *p++;
+        if (c != '\\') { s[len++] = c; continue; }
+        c = *p++;
+        switch (c) {
+        case 'n': s[len++] = '\n'; break;
+        case 't': s[len++] = '\t'; break;
+        case 'r': s[len++] = '\r'; break;
+        case 'b': s[len++] = '\b'; break;
+        case 'f': s[len++] = '\f'; break;
+        case '"': case '\\': case '/': s[len++] = c; break;
+        case 'u': {
+            long v = json_hex4(p);
+            if (v < 0) { free(s); return NULL; }
+            p += 4;
+            if (v >= 0xD800 && v < 0xDC00) {
+                long lo = p[0] == '\\' && p[1] == 'u' ? json_hex4(p + 2) : -1;
+                if (lo < 0xDC00 || lo >= 0xE000) { free(s); return NULL; }
+                v = 0x10000 + ((v - 0xD800) << 10) + (lo - 0xDC00);
+                p += 6;
+            } else if (v >= 0xDC00 && v < 0xE000) {
+                v = -1;
+            }
+            if (v <= 0) { free(s); return NULL; }
+            if (v < 0x80) s[len++] = (char)v;
+            else if (v < 0x800) { s[len++] = (char)(0xC0 | (v >> 6)); s[len++] = (char)(0x80 | (v & 0x3F)); }
+            else if (v < 0x10000) { s[len++] = (char)(0xE0 | (v >> 12)); s[len++] = (char)(0x80 | ((v >> 6) & 0x3F)); s[len++] = (char)(0x80 | (v & 0x3F)); }
+            else {
+                s[len++] = (char)(0xF0 | (v >> 18));
+                s[len++] = (char)(0x80 | ((v >> 12) & 0x3F));
+                s[len++] = (char)(0x80 | ((v >> 6) & 0x3F));
+                s[len++] = (char)(0x80 | (v & 0x3F));
+            }
+            break;
+        }
+        default: free(s); return NULL;
+        }
+    }
+    if (*p != '"') { free(s); return NULL; }
+    s[len] = '\0';
+    *out = s;
+    return p + 1;
+}
+
+/* Skip any JSON value; returns the position after it or NULL. */
+static const char *json_skip(const char *p) {
+    p = json_ws(p);
+    if (*p == '"') {
+        for (p++; *p && *p != '"'; p++)
+            if (*p == '\\' && p[1]) p++;
+        return *p ? p + 1 : NULL;
+    }
+    if (*p == '{' || *p == '[') {
+        char close = *p == '{' ? '}' : ']';
+        p = json_ws(p + 1);
+        if (*p == close) return p + 1;
+        for (;;) {
+            if (close == '}') {
+                p = json_skip(p);
+                if (!p) return NULL;
+                p = json_ws(p);
+                if (*p++ != ':') return NULL;
+            }
+            p = json_skip(p);
+            if (!p) return NULL;
+            p = json_ws(p);
+            if (*p == ',') { p++; continue; }
+            return *p == close ? p + 1 : NULL;
+        }
+    }
+    const char *start = p;
+    while (*p && strchr(",}] \t\r\n", *p) == NULL) p++;
+    return p > start ? p : NULL;
+}
+
+static int parse_batch_record(const char *line, BatchJob *job) {
+    const char *p = json_ws(line);
+    if (*p++ != '{') return 0;
+    p = json_ws(p);
+    if (*p == '}') return 1;
+    for (;;) {
+        char *key = NULL;
+        p = json_string(json_ws(p), &key);
+        if (!p) return 0;
+        p = json_ws(p);
+        if (*p++ != ':') { free(key); return 0; }
+        p = json_ws(p);
+        const char *v = p;
+        if (strcmp(key, "id") == 0) {
+            p = json_skip(p);
+            if (p) { free(job->id); job->id = strndup(v, (size_t)(p - v)); }
+        } else if ((strcmp(key, "goal") == 0 || strcmp(key, "proof") == 0) && *p == '"') {
+            char **dst = key[0] == 'g' ? &job->goal : &job->proof;
+            free(*dst);
+            *dst = NULL;
+            p = json_string(p, dst);
+        } else if (strcmp(key, "premises") == 0 && *p == '[') {
+            p = json_ws(p + 1);
+            int cap = 8;
+            job->premises = calloc((size_t)cap, sizeof(char*));
+            if (!job->premises) p = NULL;
+            while (p && *p != ']') {
+                if (job->n_premises == cap) {
+                    char **np = realloc(job->premises, (size_t)(cap *= 2) * sizeof(char*));
+                    if (!np) { p = NULL; break; }
+                    job->premises = np;
+                }
+                p = json_string(p, &job->premises[job->n_premises]);
+                if (!p) break;
+                job->n_premises++;
+                p = json_ws(p);
+                if (*p == ',') p = json_ws(p + 1);
+                else if (*p != ']') p = NULL;
+            }
+            if (p) p++;
+        } else {
+            p = json_skip(p);
+        }
+        free(key);
+        if (!p) return 0;
+        p = json_ws(p);
+        if (*p == ',') { p++; continue; }
+        return *p == '}';
+    }
+}
+
+static void free_batch_job(BatchJob *job) {
+    free(job->id);
+    for (int k = 0; k < job->n_premises; ++k) free(job->premises[k]);
+    free(job->premises);
+    free(job->goal);
+    free(job->proof);
+    free(job->path);
+    free(job->result);
+    free(job);
+}
+
+static int json_append_string(StrBuf *sb, const char *s) {
+    if (!sb_appendf(sb, "\"")) return 0;
+    for (const char *p = s; *p; ++p) {
+        unsigned char c = (unsigned char)*p;
+        int ok;
+        if (c == '"' || c == '\\') ok = sb_appendf(sb, "\\%c", c);
+        else if (c == '\n') ok = sb_appendf(sb, "\\n");
+        else if (c < 0x20) ok = sb_appendf(sb, "\\u%04x", c);
+        else ok = sb_appendf(sb, "%c", c);
+        if (!ok) return 0;
+    }
+    return sb_appendf(sb, "\"");
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void run_batch_job(BatchJob *job) {
+    char *out = NULL;
+    int rc;
+    double t0 = now_us();
+    if (job->path && !job->proof && !job->io_error) {
+        InputSpan in;
+        if (open_input(job->path, &in) != 0) {
+            job->io_error = errno ? errno : EIO;
+        } else {
+            job->proof = strndup(in.data ? in.data : "", in.len);
+            close_input(&in);
+        }
+    }
+    if (job->io_error) {
+        rc = -301;
+        out = strdup(strerror(job->io_error));
+    } else if (job->malformed || !job->proof) {
+        rc = -300;
+        out = strdup(job->malformed ? "Malformed JSON record\n" : "Record has no proof\n");
+    } else {
+        if (atomic_load_explicit(&g_trace_on, memory_order_relaxed)) {
+            /* label the verify span with the record id, unquoted when it is a string */
+            char *id = NULL;
+            if (job->id && json_string(job->id, &id)) pc_trace_set_id(id);
+            else pc_trace_set_id(job->id);
+            free(id);
+        }
+        /* a record with a goal but no "premises" has none: NULL would leave
+           its Premise lines unchecked */
+        static const char *const no_premises[1] = { NULL };
+        const char *const *premises = (const char *const *)job->premises;
+        if (!premises && job->goal) premises = no_premises;
+        rc = verify_proof_goal(job->proof, premises, job->n_premises, job->goal, &out);
+    }
+    double us = now_us() - t0;
+    uint64_t span = trace_begin();
+    StrBuf sb;
+    if (!sb_init(&sb)) { perror("malloc"); exit(EXIT_FAILURE); }
+    int ok = sb_appendf(&sb, "{\"id\":%s,\"rc\":%d,\"valid\":%s,\"us\":%.1f,\"output\":",
+                        job->id ? job->id : "null", rc, rc == 0 ? "true" : "false", us)
+          && json_append_string(&sb, out ? out : "")
+          && sb_appendf(&sb, "}\n");
+    if (!ok) { perror("malloc"); exit(EXIT_FAILURE); }
+    trace_end("format result", span, "bytes", (long)sb.len);
+    free_output(out);
+    job->result = sb.buf;
+}
+
+/* Write a completed job (caller holds the lock). */
+static void batch_complete(BatchState *bs, BatchJob *job) {
+    if (!bs->ordered) {
+        fputs(job->result, bs->out);
+        free_batch_job(job);
+        bs->in_flight--;
+    } else {
+        bs->ready[job->seq % bs->window] = job;
+        BatchJob *j;
+        while ((j = bs->ready[bs->next_write % bs->window]) && j->seq == bs->next_write) {
+            bs->ready[bs->next_write % bs->window] = NULL;
+            fputs(j->result, bs->out);
+            free_batch_job(j);
+            bs->next_write++;
+            bs->in_flight--;
+        }
+    }
+    pthread_cond_signal(&bs->can_read);
+}
+
+static void *batch_worker(void *arg) {
+    BatchState *bs = arg;
+    pthread_mutex_lock(&bs->mu);
+    for (;;) {
+        while (!bs->head && !bs->eof) pthread_cond_wait(&bs->have_work, &bs->mu);
+        if (!bs->head) break;
+        BatchJob *job = bs->head;
+        bs->head = job->next;
+        if (!bs->head) bs->tail = NULL;
+        pthread_mutex_unlock(&bs->mu);
+        run_batch_job(job);
+        pthread_mutex_lock(&bs->mu);
+        batch_complete(bs, job);
+    }
+    pthread_mutex_unlock(&bs->mu);
+    return NULL;
+}
+
+static int batch_start(BatchState *bs, FILE *out, int jobs, int ordered) {
+    memset(bs, 0, sizeof *bs);
+    pthread_mutex_init(&bs->mu, NULL);
+    pthread_cond_init(&bs->can_read, NULL);
+    pthread_cond_init(&bs->have_work, NULL);
+    bs->window = 4 * jobs;
+    bs->ordered = ordered;
+    bs->out = out;
+    bs->jobs = jobs;
+    bs->ready = calloc((size_t)bs->window, sizeof(BatchJob*));
+    bs->threads = calloc((size_t)jobs, sizeof(pthread_t));
+    if (!bs->ready || !bs->threads) { perror("calloc"); return 0; }
+    /* run with the workers that could be started; without any, give up */
+    int started = 0;
+    for (int t = 0; t < jobs; ++t) {
+        int err = pthread_create(&bs->threads[started], NULL, batch_worker, bs);
+        if (err) { fprintf(stderr, "pthread_create: %s\n", strerror(err)); break; }
+        started++;
+    }
+    bs->jobs = started;
+    if (started == 0) {
+        free(bs->threads);
+        free(bs->ready);
+        pthread_mutex_destroy(&bs->mu);
+        pthread_cond_destroy(&bs->can_read);
+        pthread_cond_destroy(&bs->have_work);
+        return 0;
+    }
+    return 1;
+}
+
+/* Queue a job, blocking while the in-flight window is full. */
+static void batch_submit(BatchState *bs, BatchJob *job) {
+    pthread_mutex_lock(&bs->mu);
+    while (bs->in_flight >= bs->window) pthread_cond_wait(&bs->can_read, &bs->mu);
+    job->seq = bs->next_seq++;
+    bs->in_flight++;
+    if (bs->tail) bs->tail->next = job; else bs->head = job;
+    bs->tail = job;
+    pthread_cond_signal(&bs->have_work);
+    pthread_mutex_unlock(&bs->mu);
+}
+
+static void batch_finish(BatchState *bs) {
+    pthread_mutex_lock(&bs->mu);
+    bs->eof = 1;
+    pthread_cond_broadcast(&bs->have_work);
+    pthread_mutex_unlock(&bs->mu);
+    for (int t = 0; t < bs->jobs; ++t) pthread_join(bs->threads[t], NULL);
+    fflush(bs->out);
+    free(bs->threads);
+    free(bs->ready);
+    pthread_mutex_destroy(&bs->mu);
+    pthread_cond_destroy(&bs->can_read);
+    pthread_cond_destroy(&bs->have_work);
+}
+
+static int run_batch(FILE *in, FILE *out, int jobs, int ordered) {
+    BatchState bs;
+    if (!batch_start(&bs, out, jobs, ordered)) return 2;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, in)) > 0) {
+        const char *p = json_ws(line);
+        if (*p == '\0') continue;
+        BatchJob *job = calloc(1, sizeof(BatchJob));
+        if (!job) { perror("calloc"); exit(EXIT_FAILURE); }
+        job->malformed = !parse_batch_record(line, job);
+        batch_submit(&bs, job);
+    }
+    free(line);
+    batch_finish(&bs);
+    return 0;
+}
+
+/* ---------------- Bulk verification of proof directories ---------------- */
+
+/* --dir walks a directory tree and verifies every regular file through the
+   batch worker pool. With io_uring the walker loads files DIR_QD at a time:
+   one submission opens the whole group, a second reads every file into a
+   buffer of its exact size (each read linked to the close of its file), so
+   a group costs two io_uring_enter calls instead of 3 * DIR_QD syscalls.
+   A file of 4 GiB or more does not fit one read request; the workers map
+   it instead, as they do every file without io_uring.  Without io_uring (old kernel, seccomp, --no-uring) the workers open and
+   read their files themselves. */
+
+#define DIR_QD 64
+
+typedef struct {
+    char *path;
+    size_t size;
+    int fd;
+    char *buf;
+    int err;
+} DirFile;
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+typedef struct {
+    int fd;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+    unsigned pending;     // submitted, not yet reaped
+} Uring;
+
+static int uring_init(Uring *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    memset(r, 0, sizeof *r);
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return 0;
+    r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_len > r->sq_len) r->sq_len = r->cq_len;
+        r->cq_len = r->sq_len;
+    }
+    r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) { close(r->fd); return 0; }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) { munmap(r->sq_ptr, r->sq_len); close(r->fd); return 0; }
+    }
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        munmap(r->sq_ptr, r->sq_len);
+        if (r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_len);
+        close(r->fd);
+        return 0;
+    }
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 1;
+}
+
+static void uring_free(Uring *r) {
+    munmap(r->sqes, r->sqes_len);
+    if (r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_len);
+    munmap(r->sq_ptr, r->sq_len);
+    close(r->fd);
+}
+
+static struct io_uring_sqe *uring_sqe(Uring *r) {
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof *sqe);
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->pending++;
+    return sqe;
+}
+
+/* Submit everything queued and wait for all of it; cb gets each completion. */
+static int uring_run(Uring *r, unsigned to_submit, void (*cb)(void *ctx, uint64_t data, int res), void *ctx) {
+    unsigned want = r->pending;
+    while (want > 0) {
+        int n = (int)syscall(__NR_io_uring_enter, r->fd, to_submit, want, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n < 0 && errno != EINTR) return 0;
+        if (n > 0) to_submit -= (unsigned)n < to_submit ? (unsigned)n : to_submit;
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head, --want) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            cb(ctx, cqe->user_data, cqe->res);
         }
-        buf[len++] = (char)c;
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
     }
-    buf[len] = '\0';
+    r->pending = 0;
+    return 1;
+}
+
+#define DIR_OP_SHIFT 32
+enum { DIR_OP_OPEN = 1, DIR_OP_READ, DIR_OP_CLOSE };
+
+static void dir_on_cqe(void *ctx, uint64_t data, int res) {
+    DirFile *files = ctx;
+    DirFile *f = &files[data & 0xFFFFFFFFu];
+    switch ((int)(data >> DIR_OP_SHIFT)) {
+    case DIR_OP_OPEN:
+        if (res < 0) f->err = -res; else f->fd = res;
+        break;
+    case DIR_OP_READ:
+        /* a short read cancels the linked close; finish both synchronously */
+        if (res < 0) f->err = -res;
+        else if ((size_t)res < f->size) {
+            size_t got = (size_t)res;
+            while (got < f->size) {
+                ssize_t k = pread(f->fd, f->buf + got, f->size - got, (off_t)got);
+                if (k <= 0) break;
+                got += (size_t)k;
+            }
+            f->size = got;
+        }
+        break;
+    case DIR_OP_CLOSE:
+        if (res == -ECANCELED) close(f->fd);
+        f->fd = -1;
+        break;
+    }
+}
+
+/* Open, read and close a group of files with two io_uring submissions.
+   Files too large for one read request are left to the workers. */
+static int uring_load_group(Uring *r, DirFile *files, int n) {
+    unsigned queued = 0;
+    for (int i = 0; i < n; ++i) {
+        files[i].fd = -1;
+        if (files[i].size >= UINT32_MAX) continue;
+        struct io_uring_sqe *sqe = uring_sqe(r);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t)(uintptr_t)files[i].path;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = ((uint64_t)DIR_OP_OPEN << DIR_OP_SHIFT) | (uint64_t)i;
+        queued++;
+    }
+    if (queued > 0 && !uring_run(r, queued, dir_on_cqe, files)) return 0;
+    queued = 0;
+    for (int i = 0; i < n; ++i) {
+        if (files[i].fd < 0) continue;
+        files[i].buf = malloc(files[i].size + 1);
+        if (!files[i].buf) { perror("malloc"); exit(EXIT_FAILURE); }
+        struct io_uring_sqe *sqe = uring_sqe(r);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = files[i].fd;
+        sqe->addr = (uint64_t)(uintptr_t)files[i].buf;
+        sqe->len = (unsigned)files[i].size;
+        sqe->off = 0;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = ((uint64_t)DIR_OP_READ << DIR_OP_SHIFT) | (uint64_t)i;
+        sqe = uring_sqe(r);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = files[i].fd;
+        sqe->user_data = ((uint64_t)DIR_OP_CLOSE << DIR_OP_SHIFT) | (uint64_t)i;
+        queued += 2;
+    }
+    return queued == 0 || uring_run(r, queued, dir_on_cqe, files);
+}
+#endif /* HAVE_IO_URING */
+
+/* nftw offers no user pointer, so the walk state is file-scope. */
+static struct {
+    BatchState *bs;
+    DirFile group[DIR_QD];
+    int n;
+    int use_uring;
+#ifdef HAVE_IO_URING
+    Uring ring;
+#endif
+} g_walk;
+
+static char *json_quote(const char *s) {
+    StrBuf sb;
+    if (!sb_init(&sb) || !json_append_string(&sb, s)) { perror("malloc"); exit(EXIT_FAILURE); }
+    return sb.buf;
+}
 
+/* Hand the current group to the worker pool. */
+static void walk_flush(void) {
+#ifdef HAVE_IO_URING
+    if (g_walk.use_uring && !uring_load_group(&g_walk.ring, g_walk.group, g_walk.n)) {
+        /* the ring failed as a whole: let the workers read these files */
+        for (int i = 0; i < g_walk.n; ++i) {
+            if (g_walk.group[i].fd >= 0) close(g_walk.group[i].fd);
+            g_walk.group[i].fd = -1;
+            free(g_walk.group[i].buf);
+            g_walk.group[i].buf = NULL;
+            g_walk.group[i].err = 0;
+        }
+        g_walk.use_uring = 0;
+    }
+#endif
+    for (int i = 0; i < g_walk.n; ++i) {
+        DirFile *f = &g_walk.group[i];
+        BatchJob *job = calloc(1, sizeof(BatchJob));
+        if (!job) { perror("calloc"); exit(EXIT_FAILURE); }
+        job->id = json_quote(f->path);
+        if (f->err) {
+            /* a failed read may leave a partly filled buffer: report the error */
+            job->io_error = f->err;
+            free(f->buf);
+            free(f->path);
+        } else if (f->buf) {
+            f->buf[f->size] = '\0';
+            job->proof = f->buf;
+            free(f->path);
+        } else {
+            job->path = f->path;
+        }
+        memset(f, 0, sizeof *f);
+        batch_submit(g_walk.bs, job);
+    }
+    g_walk.n = 0;
+}
+
+static int walk_visit(const char *path, const struct stat *sb, int type, struct FTW *ftw) {
+    (void)ftw;
+    if (type != FTW_F || !S_ISREG(sb->st_mode)) return 0;
+    DirFile *f = &g_walk.group[g_walk.n++];
+    memset(f, 0, sizeof *f);
+    f->path = strdup(path);
+    f->size = (size_t)sb->st_size;
+    f->fd = -1;
+    if (!f->path) { perror("strdup"); exit(EXIT_FAILURE); }
+    if (g_walk.n == DIR_QD) walk_flush();
+    return 0;
+}
+
+static int run_dir(const char *root, FILE *out, int jobs, int ordered, int use_uring) {
+    BatchState bs;
+    if (!batch_start(&bs, out, jobs, ordered)) return 2;
+    memset(&g_walk, 0, sizeof g_walk);
+    g_walk.bs = &bs;
+#ifdef HAVE_IO_URING
+    g_walk.use_uring = use_uring && uring_init(&g_walk.ring, 2 * DIR_QD);
+#else
+    (void)use_uring;
+#endif
+    int rc = nftw(root, walk_visit, 64, FTW_PHYS);
+    if (g_walk.n > 0) walk_flush();
+#ifdef HAVE_IO_URING
+    if (g_walk.use_uring) uring_free(&g_walk.ring);
+#endif
+    batch_finish(&bs);
+    if (rc != 0) { fprintf(stderr, "%s: %s\n", root, strerror(errno)); return 2; }
+    return 0;
+}
+
+static void print_profile(FILE *f, const pc_profile *prof) {
+    fprintf(f, "check: %llu ns, %lu nodes visited\n", (unsigned long long)prof->check_ns, prof->visited);
+    fprintf(f, "%-18s %8s %12s %12s\n", "rule", "lines", "ns", "visited");
+    for (int r = 0; r < PC_PROFILE_RULES; ++r) {
+        const pc_rule_cost *c = &prof->by_rule[r];
+        if (c->rule)
+            fprintf(f, "%-18s %8lu %12llu %12lu\n", c->rule, c->lines, (unsigned long long)c->ns, c->visited);
+    }
+    fprintf(f, "%-8s %-18s %8s %12s %12s\n", "line", "rule", "size", "ns", "visited");
+    for (int k = 0; k < prof->n_top; ++k) {
+        const pc_line_cost *e = &prof->top[k];
+        fprintf(f, "%-8d %-18s %8lu %12llu %12lu\n", e->line, e->rule, e->size,
+                (unsigned long long)e->ns, e->visited);
+    }
+}
+
+/* --stream: one JSON line per result, written as soon as it arrives. */
+static int print_line_result(const pc_line_result *r, void *ctx) {
+    FILE *f = ctx;
+    StrBuf sb;
+    if (!sb_init(&sb)) return 1;
+    int ok = sb_appendf(&sb, "{\"line\":%d,\"ok\":%s,\"rule\":", r->line, r->ok ? "true" : "false")
+          && (r->rule ? json_append_string(&sb, r->rule) : sb_appendf(&sb, "null"))
+          && sb_appendf(&sb, ",\"message\":")
+          && (r->message ? json_append_string(&sb, r->message) : sb_appendf(&sb, "null"))
+          && sb_appendf(&sb, "}\n");
+    if (ok) {
+        fputs(sb.buf, f);
+        fflush(f);
+    }
+    sb_free(&sb);
+    return !ok;
+}
+
+static int run_one(const char *mode, const InputSpan *in) {
     char *out = NULL;
-    int rc = verify_proof(buf, &out);
+    size_t out_len = 0;
+    int rc;
+    if (strcmp(mode, "--to-binary") == 0 || strcmp(mode, "--compress") == 0) {
+        /* conversions take NUL-terminated text */
+        char *text = strndup(in->data ? in->data : "", in->len);
+        if (!text) { perror("strndup"); return 2; }
+        if (mode[2] == 't') {
+            rc = pc_proof_to_binary(text, &out, &out_len);
+            if (rc == 0) fwrite(out, 1, out_len, stdout);
+            else fprintf(stderr, "conversion failed (%d)\n", rc);
+            free_output(out);
+            out = NULL;
+        } else {
+            rc = pc_compress_proof(text, &out);
+            if (rc != 0) fprintf(stderr, "compression failed (%d)\n", rc);
+        }
+        free(text);
+    } else if (strcmp(mode, "--from-binary") == 0) {
+        rc = pc_proof_from_binary(in->data, in->len, &out);
+        if (rc != 0) fprintf(stderr, "malformed binary proof (%d)\n", rc);
+    } else if (strcmp(mode, "--binary") == 0) {
+        rc = verify_proof_binary(in->data, in->len, &out);
+    } else if (strcmp(mode, "--stream") == 0) {
+        rc = verify_proof_stream(in->data ? in->data : "", in->len, print_line_result, stdout);
+    } else if (strcmp(mode, "--profile") == 0) {
+        pc_line_cost top[10];
+        pc_profile prof = { .top = top, .k = 10 };
+        rc = verify_proof_profile(in->data ? in->data : "", in->len, &prof, &out);
+        print_profile(stderr, &prof);
+    } else {
+        rc = verify_proof_n(in->data ? in->data : "", in->len, &out);
+    }
     if (out) {
         printf("%s", out);
         free_output(out);
     }
-    free(buf);
     return rc;
 }
-#endif
 
+static int cmp_alloc_bytes(const void *a, const void *b) {
+    unsigned long long x = ((const pc_alloc_site *)a)->bytes, y = ((const pc_alloc_site *)b)->bytes;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* Summary of the library's metrics as one JSON object (for --metrics), with
+   the allocation sites in a PC_ALLOC_PROFILE build. */
+static void print_metrics(FILE *f) {
+    static const char *names[PC_HIST_COUNT] = {
+        "verify_ns", "tokenize_ns", "parse_ns", "check_ns", "output_ns", "proof_bytes", "proof_lines",
+    };
+    pc_metrics *m = malloc(sizeof *m);
+    if (!m) { perror("malloc"); return; }
+    pc_metrics_snapshot(m, 0);
+    fprintf(f, "{\"rc\":{");
+    const char *sep = "";
+    for (int k = 0; k < PC_RC_SLOTS; ++k) {
+        if (!m->rc[k]) continue;
+        if (k == PC_RC_SLOTS - 1) fprintf(f, "%s\"other\":%llu", sep, (unsigned long long)m->rc[k]);
+        else fprintf(f, "%s\"%d\":%llu", sep, 1 - k, (unsigned long long)m->rc[k]);
+        sep = ",";
+    }
+    fprintf(f, "}");
+    for (int k = 0; k < PC_HIST_COUNT; ++k) {
+        const pc_histogram *h = &m->hist[k];
+        fprintf(f, ",\"%s\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+                names[k], (unsigned long long)h->count, h->count ? (double)h->sum / (double)h->count : 0.0,
+                (unsigned long long)pc_hist_quantile(h, 0.5), (unsigned long long)pc_hist_quantile(h, 0.9),
+                (unsigned long long)pc_hist_quantile(h, 0.99), (unsigned long long)h->max);
+    }
+    unsigned long long calls;
+    int n = pc_alloc_stats(NULL, 0, &calls, 0);
+    pc_alloc_site *sites = n > 0 ? calloc((size_t)n, sizeof *sites) : NULL;
+    if (sites) {
+        int cap = n;
+        n = pc_alloc_stats(sites, cap, &calls, 0);   // sites may have appeared since
+        if (n > cap) n = cap;
+        qsort(sites, (size_t)n, sizeof *sites, cmp_alloc_bytes);
+        fprintf(f, ",\"alloc\":{\"calls\":%llu,\"sites\":[", calls);
+        for (int k = 0; k < n; ++k)
+            fprintf(f, "%s{\"site\":\"%s:%d\",\"allocs\":%llu,\"bytes\":%llu,\"frees\":%llu,\"peak\":%llu}",
+                    k ? "," : "", sites[k].func, sites[k].line, sites[k].allocs, sites[k].bytes,
+                    sites[k].frees, sites[k].peak);
+        fprintf(f, "]}");
+        free(sites);
+    }
+    fprintf(f, "}\n");
+    free(m);
+}
+
+static int batch_main(int argc, char **argv) {
+    int jobs = 1, ordered = 1, use_uring = 1, metrics = 0;
+    size_t max_text = 0, max_report = 0;
+    int dir_mode = strcmp(argv[1], "--dir") == 0;
+    const char *path = NULL, *trace = NULL;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+        else if (strncmp(argv[i], "--jobs=", 7) == 0) jobs = atoi(argv[i] + 7);
+        else if (strcmp(argv[i], "--completion-order") == 0) ordered = 0;
+        else if (strcmp(argv[i], "--flush") == 0) setvbuf(stdout, NULL, _IOLBF, 0);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace = argv[++i];
+        else if (strcmp(argv[i], "--metrics") == 0) metrics = 1;
+        else if (strcmp(argv[i], "--max-text") == 0 && i + 1 < argc) max_text = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--max-report") == 0 && i + 1 < argc) max_report = strtoul(argv[++i], NULL, 10);
+        else if (dir_mode && strcmp(argv[i], "--no-uring") == 0) use_uring = 0;
+        else if (!path && argv[i][0] != '-') path = argv[i];
+        else { fprintf(stderr, "unknown batch option: %s\n", argv[i]); return 2; }
+    }
+    if (jobs < 1) jobs = 1;
+    if (dir_mode && !path) { fprintf(stderr, "--dir needs a directory\n"); return 2; }
+    FILE *in = NULL;
+    if (!dir_mode) {
+        in = path ? fopen(path, "r") : stdin;
+        if (!in) { fprintf(stderr, "%s: %s\n", path, strerror(errno)); return 2; }
+    }
+    if (trace) pc_trace_start(1 << 20);
+    if (metrics) pc_metrics_enable(1);
+    pc_report_limits(max_text, max_report);
+    int rc = dir_mode ? run_dir(path, stdout, jobs, ordered, use_uring)
+                      : run_batch(in, stdout, jobs, ordered);
+    if (trace && pc_trace_stop(trace) != 0) {
+        fprintf(stderr, "%s: %s\n", trace, strerror(errno));
+        if (rc == 0) rc = 2;
+    }
+    if (metrics) print_metrics(stderr);
+    if (in && path) fclose(in);
+    return rc;
+}
+
+/* --prove: search for a proof and print it; the search statistics go to stderr. */
+static int prove_main(int argc, char **argv) {
+    pc_prove_options opts = { 0 };
+    const char *goal = NULL;
+    const char **premises = calloc((size_t)argc, sizeof(char*));
+    int n = 0, threads = -1;
+    if (!premises) { perror("calloc"); return 2; }
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--max-goals") == 0 && i + 1 < argc) opts.max_goals = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) opts.max_size = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (!goal) goal = argv[i];
+        else premises[n++] = argv[i];
+    }
+    if (!goal) {
+        fprintf(stderr, "usage: %s --prove [--max-goals N] [--max-size N] [--threads N] GOAL [PREMISE...]\n", argv[0]);
+        free(premises);
+        return 2;
+    }
+    char *proof = NULL;
+    int rc = threads < 0 ? pc_prove(premises, n, goal, &opts, &proof)
+                         : pc_prove_portfolio(premises, n, goal, threads, &opts, &proof);
+    if (proof) fputs(proof, stdout);
+    if (rc == 1) fprintf(stderr, "no proof found (%lu goals expanded)\n", opts.expanded);
+    else if (rc == -220) fprintf(stderr, "not a well-formed formula among the goal and premises\n");
+    else if (rc < 0) fprintf(stderr, "proof search failed (%d)\n", rc);
+    else fprintf(stderr, "%lu goals expanded, strategy %d\n", opts.expanded, opts.strategy);
+    free_output(proof);
+    free(premises);
+    return rc < 0 ? 2 : rc;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && (strcmp(argv[1], "--batch") == 0 || strcmp(argv[1], "--dir") == 0))
+        return batch_main(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--prove") == 0)
+        return prove_main(argc, argv);
+    static const char *const modes[] = {
+        "--binary", "--to-binary", "--from-binary", "--compress", "--profile", "--stream",
+    };
+    const char *mode = "";
+    int first = 1;
+    if (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+        for (size_t k = 0; k < sizeof modes / sizeof *modes && !*mode; ++k)
+            if (strcmp(argv[1], modes[k]) == 0) mode = argv[1];
+        if (!*mode) {
+            fprintf(stderr, "unknown option: %s\n"
+                    "usage: %s [--binary | --to-binary | --from-binary | --compress | --profile | --stream] [FILE...]\n"
+                    "       %s --batch [OPTIONS] [FILE] | --dir [OPTIONS] DIR\n"
+                    "       %s --prove [OPTIONS] GOAL [PREMISE...]\n",
+                    argv[1], argv[0], argv[0], argv[0]);
+            return 2;
+        }
+        first = 2;
+    }
+    int nfiles = argc - first;
+    int status = 0;
+    for (int i = 0; i < (nfiles > 0 ? nfiles : 1); ++i) {
+        const char *path = nfiles > 0 ? argv[first + i] : NULL;
+        InputSpan in;
+        if (open_input(path, &in) != 0) {
+            fprintf(stderr, "%s: %s\n", path ? path : "<stdin>", strerror(errno));
+            if (status == 0) status = 2;
+            continue;
+        }
+        if (nfiles > 1) printf("==> %s <==\n", path);
+        int rc = run_one(mode, &in);
+        if (status == 0) status = rc;
+        close_input(&in);
+    }
+    return status;
+}
+#endif
@@ -1,6 +1,9 @@
 #ifndef PROOF_CHECKER_H
 #define PROOF_CHECKER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -10,11 +13,298 @@ extern "C" {
 // On error (parse/internal): returns negative values.
 // The function allocates an output string with malloc and stores it into *output.
 // Caller must call free_output(*output) (or free) when done.
+// verify_proof is thread-safe: concurrent calls only share the formula store.
 int verify_proof(const char *input, char **output);
 
+// Same as verify_proof for a proof given as a span of `len` bytes that need
+// not be NUL-terminated (e.g. an mmap'd file); the input is not copied.
+int verify_proof_n(const char *input, size_t len, char **output);
+
+// Verify a proof of `goal` from `premises`: in addition to verify_proof's
+// checks, every Premise line must be one of the given premises and the last
+// line must be the goal. Pass premises == NULL to leave Premise lines
+// unconstrained, goal == NULL to skip the goal check. Returns -220 if a
+// premise or the goal is not a WFF; otherwise as verify_proof.
+int verify_proof_goal(const char *input, const char *const *premises, int n_premises,
+                      const char *goal, char **output);
+
+// Bound the size of verify reports (for all threads). Formulas and
+// justifications longer than `max_text` bytes are shown as their first and
+// last max_text/2 bytes around "...[<length> bytes #<64-bit FNV-1a hash>]...".
+// Once a report reaches `max_report` bytes, later messages are dropped and
+// the report ends with "[report truncated: <n> messages omitted]" (for
+// verify_proof_stream, a final result with line == 0). Texts the marker
+// would not shorten are shown whole.
+// 0 disables a limit; both are off by default.
+void pc_report_limits(size_t max_text, size_t max_report);
+
+// Verdict of one proof line, passed to a pc_line_callback. The strings are
+// only valid during the callback.
+typedef struct {
+    int line;                  // line number; 0 for a message about the whole proof
+    int ok;                    // 1 if the line is valid
+    const char *rule;          // "Premise", "AX1", "MP", ... (NULL when line == 0)
+    const char *formula;       // the line's formula text (NULL when line == 0)
+    const char *justification; // the line's justification text (NULL when line == 0)
+    const char *message;       // diagnostics, newline-terminated, or NULL
+} pc_line_result;
+
+// Return 0 to continue, nonzero to stop checking.
+typedef int (*pc_line_callback)(const pc_line_result *result, void *ctx);
+
+// Verify a proof like verify_proof_n, but instead of building a report,
+// pass each line's verdict to `cb` as soon as it is known. Read and parse
+// errors and the goal check arrive as results with line == 0. The library
+// keeps only the current line's messages, so memory does not grow with
+// the report. Returns as verify_proof_n, or -230 if the callback stopped
+// the check.
+int verify_proof_stream(const char *input, size_t len, pc_line_callback cb, void *ctx);
+
+// Cost of checking one proof line, as reported by verify_proof_profile.
+typedef struct {
+    int line;              // line number in the proof
+    const char *rule;      // "Premise", "AX1", "MP", "Substitution", ... (static string)
+    unsigned long size;    // nodes in the line's formula
+    unsigned long visited; // formula nodes visited while checking the line
+    uint64_t ns;           // time spent checking the line
+} pc_line_cost;
+
+// Totals for all lines justified by one rule.
+typedef struct {
+    const char *rule;      // NULL for rules that did not occur
+    unsigned long lines;
+    unsigned long visited;
+    uint64_t ns;
+} pc_rule_cost;
+
+#define PC_PROFILE_RULES 11
+
+typedef struct {
+    pc_line_cost *top;     // in: room for k entries (may be NULL if k == 0)
+    int k;                 // in
+    int n_top;             // out: entries filled in, most expensive first
+    uint64_t check_ns;     // out: time spent checking all lines
+    unsigned long visited; // out: nodes visited checking all lines
+    pc_rule_cost by_rule[PC_PROFILE_RULES]; // out
+} pc_profile;
+
+// Same as verify_proof_n, and also measures every line's check: fills in the
+// k lines that took longest and the totals per rule. "visited" counts do not
+// depend on timing noise, so they are the better measure for comparing proof
+// shapes. If the proof fails to read or parse, no line is checked and the
+// profile is empty.
+int verify_proof_profile(const char *input, size_t len, pc_profile *prof, char **output);
+
 // Free an output string returned by verify_proof.
 void free_output(char *p);
 
+// ---------------- Proof search ----------------
+// pc_prove searches backwards from the goal: it proposes MP steps whose
+// formulas close the goal (axiom instances matched against it, implication
+// chains of the premises, subformulas of the premises and goal) and expands
+// the resulting subgoals best first, smallest first. Goals that are proved
+// or known to fail are remembered, so each is searched once.
+// pc_prove_portfolio runs differently tuned searches on several threads,
+// sharing what each proves, and keeps the first proof that checks.
+
+typedef struct {
+    unsigned long max_goals;   // in: goals to expand before giving up (0 = 20000)
+    unsigned max_size;         // in: largest formula to try, in symbols
+                               //     (0 = 4 x the largest premise or goal + 16)
+    unsigned step_cost;        // in: extra cost of each MP step, in symbols (0 = 4)
+    int largest_first;         // in: try large subformulas as MP minors first
+    int forward;               // in: saturate forwards from the premises and
+                               //     axiom instances instead
+    unsigned long expanded;    // out: goals expanded (by all threads)
+    int strategy;              // out: strategy that found the proof, or -1
+} pc_prove_options;
+
+// Search for a proof of `goal` from `premises` using AX1-AX3 and MP (and
+// Lemma, for lemmas of the attached store). opts may be NULL. On success
+// returns 0 and stores the proof, in the line format verify_proof reads, in
+// *proof (free with free_output). Returns 1 if no proof was found within the
+// limits, -220 if a premise or the goal is not a WFF, -102 if memory or the
+// search's formula table ran out.
+int pc_prove(const char *const *premises, int n_premises, const char *goal,
+             pc_prove_options *opts, char **proof);
+
+// Run up to `threads` strategies of pc_prove at once (<= 0: one per CPU, at
+// most 8), backwards with different step costs, size bounds and minor
+// orders, and forwards. Formulas any of them proves close the same goals in
+// the others. The first proof that passes verify_proof_goal is returned and
+// the other searches are stopped; opts->strategy tells which one it was.
+// Only max_goals (per strategy) and max_size are read from opts. Return
+// codes as for pc_prove.
+int pc_prove_portfolio(const char *const *premises, int n_premises, const char *goal,
+                       int threads, pc_prove_options *opts, char **proof);
+
+// ---------------- Compressed proofs ----------------
+// verify_proof also accepts formulas written with back-references:
+//   @k  the formula of earlier line k
+//   *F  subformula F, saved as the next definition (numbered 1, 2, ... across the proof)
+//   $k  definition k
+// e.g. "c*cPQ$1" is the formula ccPQcPQ. Such proofs are decoded without
+// expanding them to text; reports show the formulas as written.
+
+// Rewrite a text proof using back-references. On success returns 0 and stores
+// the malloc'd text in *out (free with free_output).
+int pc_compress_proof(const char *input, char **out);
+
+// ---------------- Binary proof format ----------------
+// A versioned, pre-parsed encoding of a proof: a deduplicated formula table
+// in prefix-array form plus one fixed-size record per line (rule + operands).
+// Binary proofs are checked without any text tokenizing or parsing, and can
+// be verified straight from an mmap'd file. Native byte order.
+
+// Verify a binary proof of `len` bytes (buf must be 4-byte aligned).
+// Same output and return codes as verify_proof, plus -210 for a malformed buffer.
+int verify_proof_binary(const void *buf, size_t len, char **output);
+
+// Convert a text proof to the binary format. On success returns 0 and stores
+// a malloc'd buffer in *out (free with free_output) and its size in *out_len.
+// Fails if a formula is not a WFF or a justification is not recognized.
+int pc_proof_to_binary(const char *input, char **out, size_t *out_len);
+
+// Convert a binary proof back to text (malloc'd, free with free_output).
+int pc_proof_from_binary(const void *buf, size_t len, char **text);
+
+// ---------------- Shared formula store (optional) ----------------
+// Formulas of every checked proof are interned into a store that can be
+// shared by all worker processes on a node through a POSIX shared-memory
+// segment. Once a store is attached, formulas proved by a premise-free valid
+// proof are recorded as lemmas and may be cited by later proofs (in any
+// attached process) with the justification "Lemma". Worker threads share the
+// store too; its lookups and inserts are lock-free.
+// Attach/create/restore/detach must not race with running verify_proof calls.
+
+#define PC_STORE_DEFAULT_CAPACITY (1u << 20)
+
+// Attach to the shared-memory store `name` (e.g. "/proofchecker"), creating it
+// with room for `capacity` formulas (0 = default) if it does not exist yet.
+// Returns 0 on success, negative on error.
+int pc_store_attach_shared(const char *name, unsigned capacity);
+
+// Create a store private to this process, with room for `capacity` formulas
+// (0 = default). It persists across verify_proof calls and is reclaimable:
+// when it holds more than the high watermark (default 3/4 of capacity) it is
+// swept down to the low watermark (default 1/2), keeping lemmas and the most
+// recently used formulas. Returns 0 on success, negative on error.
+int pc_store_create(unsigned capacity);
+
+// Set the sweep watermarks of a private store (created or restored);
+// high == 0 disables reclamation. Shared segments are append-only and are
+// never swept. Returns 0 on success, negative on error.
+int pc_store_set_watermarks(unsigned high, unsigned low);
+
+// Detach from the current store (a shared segment itself is left in place).
+void pc_store_detach(void);
+
+// Write the attached store (interned formulas and lemmas) to `path`.
+// The file has the same layout as the store itself and contains no pointers,
+// so it can be mapped back by any process. Returns 0 on success.
+int pc_store_snapshot(const char *path);
+
+// Map a snapshot written by pc_store_snapshot as this process's store, without
+// re-parsing or re-verifying anything. The mapping is private: formulas and
+// lemmas added afterwards are not written back to the file, and the store is
+// reclaimable like one made by pc_store_create. A truncated file, or one whose
+// entries or slots point outside the used part of the store, is refused.
+// Returns 0 on success, negative on error.
+int pc_store_restore(const char *path);
+
+// Intern a formula (prefix notation) and return its id: structurally equal
+// formulas get the same id in every thread (and, for a shared segment, every
+// process), so ids can be used to deduplicate candidates. Returns 0 if no
+// store is attached, the text is not a WFF, or the store is full.
+// Ids of a private store are renumbered by a sweep; disable reclamation with
+// pc_store_set_watermarks(0, 0) if callers keep ids across calls.
+unsigned pc_store_intern(const char *formula);
+
+// Number of interned formulas and recorded lemmas. Returns -1 if no store is attached.
+int pc_store_stats(unsigned *formulas, unsigned *lemmas);
+
+// Start recording trace spans (verify, tokenize, parse, one per checked line
+// named after its rule, output) in every thread that verifies. Each thread
+// keeps up to `events_per_thread` events; later ones are dropped and counted.
+// Returns 0 on success, -1 on a bad size, -2 if tracing is already on.
+int pc_trace_start(size_t events_per_thread);
+
+// Label the "verify" spans subsequently recorded by the calling thread
+// (e.g. with a record id). NULL clears the label.
+void pc_trace_set_id(const char *proof_id);
+
+// Stop tracing, write the recorded spans to `path` as Chrome trace-event
+// JSON (chrome://tracing, Perfetto) and free them; a NULL path discards them.
+// Must not run concurrently with verify calls.
+// Returns 0 on success, -1 if tracing was off, -2 if the file could not be written.
+int pc_trace_stop(const char *path);
+
+// Allocations made at one call site in the checker during verify calls
+// (PC_ALLOC_PROFILE builds).
+typedef struct {
+    const char *func;        // function containing the call site
+    int line;
+    unsigned long long allocs;
+    unsigned long long bytes;   // bytes requested
+    unsigned long long frees;   // frees of blocks from this site seen by the profiler
+    unsigned long long peak;    // most bytes from this site live at once within one verify call
+} pc_alloc_site;
+
+// Copy up to `max` call sites that allocated (since the last reset) into
+// `out` and store the number of verify calls profiled in *calls; with
+// reset != 0 the counters restart from zero.
+// Returns the number of sites (which may exceed max), or -1 if the library
+// was built without -DPC_ALLOC_PROFILE.
+int pc_alloc_stats(pc_alloc_site *out, int max, unsigned long long *calls, int reset);
+
+// Latency, size and return-code metrics of verify calls, kept in lock-free
+// log-linear histograms (16 sub-buckets per power of two, so a bucket is
+// within 6.25% of any value in it). Off by default.
+enum {
+    PC_HIST_VERIFY_NS,     // whole verify_proof* call
+    PC_HIST_TOKENIZE_NS,   // reading the proof text (or decoding a binary proof)
+    PC_HIST_PARSE_NS,      // parsing the formulas
+    PC_HIST_CHECK_NS,      // checking the justifications
+    PC_HIST_OUTPUT_NS,     // copying out the report
+    PC_HIST_PROOF_BYTES,   // input size
+    PC_HIST_PROOF_LINES,   // proof lines read
+    PC_HIST_COUNT
+};
+
+#define PC_HIST_BUCKETS 976
+#define PC_RC_SLOTS 512
+// Slot of a return code in pc_metrics.rc: 1 -> 0, 0 -> 1, -k -> k + 1;
+// codes that do not fit share the last slot.
+#define PC_RC_SLOT(rc) ((rc) > 1 ? PC_RC_SLOTS - 1 : 1 - (rc) < PC_RC_SLOTS - 1 ? 1 - (rc) : PC_RC_SLOTS - 1)
+
+typedef struct {
+    uint64_t count;        // sum of buckets
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[PC_HIST_BUCKETS];
+} pc_histogram;
+
+typedef struct {
+    pc_histogram hist[PC_HIST_COUNT];
+    uint64_t rc[PC_RC_SLOTS];
+} pc_metrics;
+
+// Turn metric collection on (nonzero) or off. Costs a few clock reads and
+// atomic increments per verify call while on.
+void pc_metrics_enable(int on);
+
+// Copy the current metrics into *out; with reset != 0 the counters are
+// zeroed as they are read, so every recorded call lands in exactly one
+// snapshot. Safe to call while other threads verify; count and sum of a
+// histogram may then be off by the calls in flight.
+void pc_metrics_snapshot(pc_metrics *out, int reset);
+
+// Largest value that falls into bucket `b` of a pc_histogram.
+uint64_t pc_hist_bucket_max(int b);
+
+// Approximate q-quantile (0 <= q <= 1) of a histogram; 0 if it is empty.
+uint64_t pc_hist_quantile(const pc_histogram *h, double q);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,192 @@
+# shard_runner.py
+# Verifies a JSONL archive (the proof_checker --batch record format) across
+# several checker processes, one per core, and merges their results.
+#
+#   python3 shard_runner.py archive.jsonl -P 8 -o results.jsonl
+#
+# Records are dealt round-robin into P shard files; shard i runs
+# `proof_checker --batch --jobs 1 --flush` pinned to the i-th allowed CPU.
+# Every shard is a separate process, so a proof that crashes its checker
+# takes down only that shard. With --flush each result is written as soon
+# as it is ready, so the first record without a result is the one that
+# crashed: the runner reports it with rc -302 and restarts the shard on the
+# records after it. Results come back in input order and a JSON summary of
+# the run is printed to stderr.
+import argparse
+import collections
+import json
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+CHECKER_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "proof_checker")
+RC_CRASHED = -302
+
+
+def _record_id(line):
+    try:
+        rec = json.loads(line)
+        return rec.get("id") if isinstance(rec, dict) else None
+    except ValueError:
+        return None
+
+
+def _crash_result(line, returncode):
+    if returncode < 0:
+        what = "checker killed by %s" % signal.Signals(-returncode).name
+    else:
+        what = "checker exited with status %d" % returncode
+    return json.dumps({"id": _record_id(line), "rc": RC_CRASHED, "valid": False,
+                       "us": 0.0, "output": what + "\n"}) + "\n"
+
+
+class Shard:
+    def __init__(self, index, cpu, workdir, checker):
+        self.index = index
+        self.cpu = cpu
+        self.checker = checker
+        self.in_path = os.path.join(workdir, "shard%d.in" % index)
+        self.out_path = os.path.join(workdir, "shard%d.out" % index)
+        self.records = 0
+        self.rc_counts = collections.Counter()
+        self.valid = 0
+        self.crashes = 0
+        self.verify_us = 0.0
+        self.wall = 0.0
+
+    def _spawn(self, stdin):
+        cpu = self.cpu
+        def pin():
+            if cpu is not None:
+                os.sched_setaffinity(0, {cpu})
+        return subprocess.Popen([self.checker, "--batch", "--jobs", "1", "--flush"], stdin=stdin,
+                                stdout=subprocess.PIPE, preexec_fn=pin)
+
+    def _account(self, line):
+        try:
+            res = json.loads(line)
+        except ValueError:
+            return
+        self.rc_counts[res.get("rc")] += 1
+        self.valid += bool(res.get("valid"))
+        self.verify_us += res.get("us", 0.0)
+
+    def run(self):
+        start = time.monotonic()
+        path = self.in_path
+        done = 0
+        with open(self.out_path, "w") as out:
+            while done < self.records:
+                with open(path, "rb") as stdin:
+                    proc = self._spawn(stdin)
+                    got = 0
+                    for raw in proc.stdout:
+                        line = raw.decode("utf-8", "replace")
+                        out.write(line)
+                        self._account(line)
+                        got += 1
+                    proc.wait()
+                done += got
+                if done >= self.records:
+                    break
+                # The process died on the record after the last result it
+                # wrote. Report that record, then resume on the rest.
+                rest = self._remaining(path, got)
+                out.write(_crash_result(rest[0], proc.returncode))
+                self.rc_counts[RC_CRASHED] += 1
+                self.crashes += 1
+                done += 1
+                path = self.in_path + ".restart%d" % self.crashes
+                with open(path, "w") as f:
+                    f.writelines(rest[1:])
+        self.wall = time.monotonic() - start
+
+    @staticmethod
+    def _remaining(path, skip):
+        with open(path) as f:
+            return [line for i, line in enumerate(f) if i >= skip]
+
+
+def split(src, shards):
+    """Deal the non-blank records of src round-robin into the shard files."""
+    files = [open(s.in_path, "w") for s in shards]
+    n = 0
+    for line in src:
+        if not line.strip(" \t\r\n"):
+            continue   # the checker skips blank lines too
+        if not line.endswith("\n"):
+            line += "\n"
+        shard = shards[n % len(shards)]
+        files[shard.index].write(line)
+        shard.records += 1
+        n += 1
+    for f in files:
+        f.close()
+    return n
+
+
+def merge(shards, total, dst):
+    """Interleave the shard outputs back into input order."""
+    files = [open(s.out_path) for s in shards]
+    for i in range(total):
+        dst.write(files[i % len(files)].readline())
+    for f in files:
+        f.close()
+
+
+def run(src, dst, processes, checker=CHECKER_PATH, pin=True):
+    cpus = sorted(os.sched_getaffinity(0)) if pin and hasattr(os, "sched_getaffinity") else []
+    start = time.monotonic()
+    with tempfile.TemporaryDirectory(prefix="shard_runner.") as workdir:
+        shards = [Shard(i, cpus[i % len(cpus)] if cpus else None, workdir, checker)
+                  for i in range(processes)]
+        total = split(src, shards)
+        threads = [threading.Thread(target=s.run) for s in shards if s.records]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        merge(shards, total, dst)
+    wall = time.monotonic() - start
+
+    rc_counts = collections.Counter()
+    for s in shards:
+        rc_counts.update(s.rc_counts)
+    return {
+        "records": total,
+        "valid": sum(s.valid for s in shards),
+        "crashes": sum(s.crashes for s in shards),
+        "rc": {str(k): v for k, v in sorted(rc_counts.items(), key=lambda kv: str(kv[0]))},
+        "wall_s": round(wall, 3),
+        "records_per_s": round(total / wall, 1) if wall > 0 else None,
+        "verify_us": round(sum(s.verify_us for s in shards), 1),
+        "shards": [{"cpu": s.cpu, "records": s.records, "crashes": s.crashes,
+                    "wall_s": round(s.wall, 3)} for s in shards],
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Shard a JSONL proof archive across pinned checker processes.")
+    ap.add_argument("input", nargs="?", help="JSONL archive (default: stdin)")
+    ap.add_argument("-P", "--processes", type=int, default=len(os.sched_getaffinity(0)))
+    ap.add_argument("-o", "--output", help="results file (default: stdout)")
+    ap.add_argument("--checker", default=CHECKER_PATH, help="path to the standalone proof_checker")
+    ap.add_argument("--no-pin", action="store_true", help="do not pin shards to cores")
+    args = ap.parse_args()
+
+    src = open(args.input) if args.input else sys.stdin
+    dst = open(args.output, "w") if args.output else sys.stdout
+    stats = run(src, dst, max(1, args.processes), args.checker, not args.no_pin)
+    if dst is not sys.stdout:
+        dst.close()
+    json.dump(stats, sys.stderr, indent=2)
+    sys.stderr.write("\n")
+    return 1 if stats["crashes"] else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,98 @@
+# test_bench_compare.py
+# Tests for the bench_compare.py rollout gate: a uniform slowdown of the
+# corpus, a p99 or throughput regression, and a missing benchmark must fail
+# it; run-to-run jitter must not.
+#
+#   python3 test_bench_compare.py
+import json
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import unittest
+
+import bench_compare
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def corpus(times):
+    return "".join(json.dumps({"id": i, "rc": 0, "valid": True, "us": t}) + "\n"
+                   for i, t in enumerate(times))
+
+
+class GateTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.TemporaryDirectory()
+        rng = random.Random(7)
+        # proofs of very different sizes: a lognormal spread of times
+        self.times = [rng.lognormvariate(3.0, 1.2) for _ in range(300)]
+        self.rng = rng
+
+    def tearDown(self):
+        self.dir.cleanup()
+
+    def write(self, name, text):
+        path = os.path.join(self.dir.name, name)
+        with open(path, "w") as f:
+            f.write(text)
+        return path
+
+    def gate(self, baseline_files, current_files, *extra):
+        base = os.path.join(self.dir.name, "baseline.json")
+        subprocess.run([sys.executable, os.path.join(HERE, "bench_compare.py"), "save"]
+                       + baseline_files + ["-o", base], check=True, stdout=subprocess.DEVNULL)
+        return subprocess.run([sys.executable, os.path.join(HERE, "bench_compare.py"), "compare", base]
+                              + current_files + list(extra),
+                              stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+
+    def jitter(self, factor):
+        return [t * factor * self.rng.uniform(0.98, 1.02) for t in self.times]
+
+    def test_uniform_slowdown_fails(self):
+        old = self.write("corpus.jsonl", corpus(self.times))
+        new = self.write("new_corpus.jsonl", corpus(self.jitter(1.3)))
+        res = self.gate([old], [new])
+        self.assertEqual(res.returncode, 1, res.stdout)
+        rows = bench_compare.compare(bench_compare.load_results([old]), bench_compare.load_results([new]), {})
+        row = next(r for r in rows if r["name"] == "corpus")
+        self.assertEqual(row["status"], "REGRESSION")
+        self.assertAlmostEqual(row["change"], 0.3, delta=0.01)
+
+    def test_jitter_passes(self):
+        old = self.write("corpus.jsonl", corpus(self.times))
+        new = self.write("new_corpus.jsonl", corpus(self.jitter(1.0)))
+        res = self.gate([old], [new])
+        self.assertEqual(res.returncode, 0, res.stdout + res.stderr)
+
+    def test_p99_regression_fails(self):
+        # the slowest proofs get much slower; the mean gate is switched off
+        times = sorted(self.times)
+        slow = times[:-10] + [t * 3 for t in times[-10:]]
+        old = self.write("corpus.jsonl", corpus(times))
+        new = self.write("new_corpus.jsonl", corpus(slow))
+        res = self.gate([old], [new], "--threshold", "10")
+        self.assertEqual(res.returncode, 1, res.stdout)
+        self.assertIn("corpus p99", res.stderr)
+
+    def test_throughput_drop_fails(self):
+        runs = [self.write("s%d.json" % k, json.dumps({"records": 300, "records_per_s": v}, indent=2))
+                for k, v in enumerate([1000.0, 1010.0, 990.0, 1005.0])]
+        slower = [self.write("n%d.json" % k, json.dumps({"records": 300, "records_per_s": v}, indent=2))
+                  for k, v in enumerate([800.0, 805.0, 795.0, 810.0])]
+        self.assertEqual(self.gate(runs, runs).returncode, 0)
+        res = self.gate(runs, slower)
+        self.assertEqual(res.returncode, 1, res.stdout)
+        self.assertIn("throughput", res.stderr)
+
+    def test_missing_benchmark_fails(self):
+        old = self.write("corpus.jsonl", corpus(self.times))
+        kernels = self.write("kernels.jsonl", json.dumps({"name": "k", "mean_ns": 10.0, "stddev_ns": 0.1, "reps": 15}) + "\n")
+        res = self.gate([old, kernels], [old])
+        self.assertEqual(res.returncode, 1)
+        self.assertIn("missing", res.stderr)
+
+
+if __name__ == "__main__":
+    unittest.main()
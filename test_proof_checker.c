@@ -0,0 +1,688 @@
+// test_proof_checker.c
+// Behavioural regression tests for the checker: each test runs proofs
+// through the public API (and, where the behaviour lives below it, the
+// internal helpers) and checks the verdicts.
+//
+// Build (the checker source is included directly, for the internal helpers):
+//  gcc -std=c11 -O2 -Wall -pthread -o test_proof_checker test_proof_checker.c
+//
+// Run:
+//  ./test_proof_checker
+//
+// Prints one line per failed check and a summary; the exit status is 1 if
+// any check failed.
+
+#include "proof_checker.c"
+
+static int g_checks, g_failed;
+
+#define CHECK(cond) do { \
+    g_checks++; \
+    if (!(cond)) { g_failed++; fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #cond); } \
+} while (0)
+
+/* verify_proof's return code, with the report discarded. */
+static int verify_rc(const char *proof) {
+    char *out = NULL;
+    int rc = verify_proof(proof, &out);
+    free_output(out);
+    return rc;
+}
+
+/* ---------------- Packed formulas ---------------- */
+
+static unsigned g_rand = 12345;
+
+static unsigned rnd(unsigned n) {
+    g_rand = g_rand * 1103515245u + 12345u;
+    return (g_rand >> 8) % n;
+}
+
+/* A random formula of exactly n symbols at *p; atoms include A and Z, the
+   smallest and largest 5-bit codes. */
+static void gen_formula(char **p, int n) {
+    if (n == 1) { *(*p)++ = "AZPQ"[rnd(4)]; return; }
+    if (n == 2 || rnd(4) == 0) { *(*p)++ = 'n'; gen_formula(p, n - 1); return; }
+    int k = 1 + (int)rnd((unsigned)(n - 2));
+    *(*p)++ = 'c';
+    gen_formula(p, k);
+    gen_formula(p, n - 1 - k);
+}
+
+static Node *tree_of(const char *s) {
+    int idx = 0;
+    return parse_node(s, &idx);
+}
+
+/* Packed and tree formulas must agree on equality, axiom instances and MP
+   for sizes around PACK_MAX, where lines switch from one form to the other. */
+static void test_packed_boundary(void) {
+    char a[64], b[64], imp[160], proof[512];
+    for (int n = PACK_MAX - 3; n <= PACK_MAX + 2; ++n) {
+        for (int rep = 0; rep < 200; ++rep) {
+            char *p = a;
+            gen_formula(&p, n);
+            *p = '\0';
+            /* b: a itself, a with one atom changed, or another formula of n symbols */
+            strcpy(b, a);
+            if (rep % 3 == 1) {
+                int k = (int)rnd((unsigned)n);
+                while (!isupper((unsigned char)b[k])) k++;
+                b[k] = b[k] == 'Z' ? 'A' : 'Z';
+            } else if (rep % 3 == 2) {
+                p = b;
+                gen_formula(&p, n);
+                *p = '\0';
+            }
+            Packed pa, pb;
+            int packed = pack_formula(a, &pa);
+            CHECK(packed == (n <= PACK_MAX));
+            Node *ta = tree_of(a), *tb = tree_of(b);
+            if (packed && pack_formula(b, &pb))
+                CHECK((pa.bits == pb.bits) == equal_tree(ta, tb));
+            if (packed) {
+                CHECK(pack_match(AX1_PAT, &pa) == is_instance_AX1(ta));
+                CHECK(pack_match(AX2_PAT, &pa) == is_instance_AX2(ta));
+                CHECK(pack_match(AX3_PAT, &pa) == is_instance_AX3(ta));
+            }
+            free_tree(ta);
+            free_tree(tb);
+        }
+    }
+
+    /* axiom instances just inside and just outside the packed range, and
+       the same with one copy of a repeated subformula changed */
+    for (int n = PACK_MAX - 8; n <= PACK_MAX + 2; ++n) {
+        char *p = a;
+        gen_formula(&p, (n - 3) / 2);
+        *p = '\0';
+        snprintf(imp, sizeof imp, "c%scQ%s", a, a);       // AX1 instance, 2|a| + 3 symbols
+        Packed pi;
+        if (pack_formula(imp, &pi)) CHECK(pack_match(AX1_PAT, &pi));
+        snprintf(proof, sizeof proof, "1 %s AX1\n", imp);
+        CHECK(verify_rc(proof) == 0);
+        char *last = strrchr(imp, a[strlen(a) - 1]);
+        *last = *last == 'Z' ? 'A' : 'Z';
+        if (pack_formula(imp, &pi)) CHECK(!pack_match(AX1_PAT, &pi));
+        snprintf(proof, sizeof proof, "1 %s AX1\n", imp);
+        CHECK(verify_rc(proof) != 0);
+    }
+
+    /* MP with the implication packed or not, and the minor and the
+       conclusion on either side of the boundary */
+    for (int na = 1; na <= PACK_MAX; na += 3) {
+        for (int nb = PACK_MAX - 1 - na - 2; nb <= PACK_MAX - na + 1; ++nb) {
+            if (nb < 1) continue;
+            char *p = a;
+            gen_formula(&p, na);
+            *p = '\0';
+            p = b;
+            gen_formula(&p, nb);
+            *p = '\0';
+            snprintf(proof, sizeof proof, "1 %s Premise\n2 c%s%s Premise\n3 %s MP 1 2\n", a, a, b, b);
+            CHECK(verify_rc(proof) == 0);
+            size_t lb = strlen(b);
+            b[lb - 1] = b[lb - 1] == 'Z' ? 'A' : 'Z';
+            snprintf(proof + strlen(proof), sizeof proof - strlen(proof), "4 %s MP 1 2\n", b);
+            CHECK(verify_rc(proof) != 0);
+        }
+    }
+}
+
+/* ---------------- Lemmas ---------------- */
+
+/* Only formulas of valid, premise-free proofs become lemmas. */
+static void test_lemmas(void) {
+    CHECK(verify_rc("1 cPcQP Lemma\n") != 0);            // no store attached
+    CHECK(pc_store_create(1024) == 0);
+    CHECK(verify_rc("1 cPcQP Lemma\n") != 0);            // never proved
+    CHECK(verify_rc("1 cPcQP AX1\n") == 0);
+    CHECK(verify_rc("1 cPcQP Lemma\n") == 0);            // proved by the proof above
+    CHECK(verify_rc("1 cQcPQ Lemma\n") != 0);            // lemmas are not schemas
+    CHECK(verify_rc("1 cPcQP Lemma\n2 ccPcQPcRcPcQP AX1\n3 cRcPcQP MP 1 2\n") == 0);
+    CHECK(verify_rc("1 cRcPcQP Lemma\n") == 0);          // proved from a lemma
+
+    CHECK(verify_rc("1 R Premise\n") == 0);              // uses a premise
+    CHECK(verify_rc("1 R Lemma\n") != 0);
+    CHECK(verify_rc("1 cScQS AX1\n2 S AX1\n") != 0);     // invalid proof
+    CHECK(verify_rc("1 cScQS Lemma\n") != 0);
+    /* valid, but cites a later line */
+    CHECK(verify_rc("1 cQcPcQP MP 2 3\n2 cPcQP AX1\n3 ccPcQPcQcPcQP AX1\n") == 0);
+    CHECK(verify_rc("1 cQcPcQP Lemma\n") != 0);
+    pc_store_detach();
+}
+
+/* ---------------- Compressed and binary proofs ---------------- */
+
+static const char *const ROUND_TRIP[] = {
+    "1 cPcQP AX1\n",
+    "1 cPcPP AX1\n2 ccPccPPPccPcPPcPP AX2\n3 cPccPPP AX1\n4 ccPcPPcPP MP 3 2\n5 cPP MP 1 4\n",
+    "1 ccnPnQcQP AX3\n2 cnPnQ Premise\n3 cQP MP 2 1\n",
+    "1 ccPQccQRcPR Premise\n2 cccPQccQRcPRcSccPQccQRcPR AX1\n3 cSccPQccQRcPR MP 1 2\n"
+        "4 cSccRQccQRcRR Substitution P=R\n",
+    "1 cPcQP AX1\n2 cPcQQ AX1\n3 P Premise\n4 cQP MP 3 1\n5 cQQ MP 3 9\n",
+    "1 cPcQP Bogus\n2 cPcQP MP x\n",
+};
+
+/* Count the OK and INVALID verdict lines of a report. */
+static void verdicts(const char *out, int *ok, int *bad) {
+    *ok = *bad = 0;
+    for (const char *p = out; p && (p = strstr(p, "Line ")); p++) {
+        const char *colon = strchr(p, ':');
+        if (!colon) break;
+        if (strncmp(colon, ": OK:", 5) == 0) (*ok)++;
+        else if (strncmp(colon, ": INVALID:", 10) == 0) (*bad)++;
+    }
+}
+
+/* Compressing a proof changes neither its verdict nor any line's. */
+static void test_compressed_round_trip(void) {
+    char big[1024];
+    /* a proof that repeats a large subformula, so back-references pay */
+    snprintf(big, sizeof big, "1 %s Premise\n2 c%scQ%s AX1\n3 cQ%s MP 1 2\n4 cc%sQc%sQ Premise\n",
+             "ccPQcnRS", "ccPQcnRS", "ccPQcnRS", "ccPQcnRS", "ccPQcnRS", "ccPQcnRS");
+    for (size_t k = 0; k <= sizeof ROUND_TRIP / sizeof *ROUND_TRIP; ++k) {
+        const char *text = k < sizeof ROUND_TRIP / sizeof *ROUND_TRIP ? ROUND_TRIP[k] : big;
+        char *packed = NULL, *a = NULL, *b = NULL;
+        CHECK(pc_compress_proof(text, &packed) == 0);
+        if (!packed) continue;
+        if (text == big) CHECK(strlen(packed) < strlen(big) && strpbrk(packed, "@$*"));
+        int oa, ba, ob, bb;
+        CHECK(verify_proof(text, &a) == verify_proof(packed, &b));
+        verdicts(a, &oa, &ba);
+        verdicts(b, &ob, &bb);
+        CHECK(oa == ob && ba == bb && oa + ba > 0);
+        free_output(a);
+        free_output(b);
+        free_output(packed);
+    }
+}
+
+/* Malformed back-references make the formula unreadable, not a match. */
+static void test_compressed_rejects(void) {
+    CHECK(verify_rc("1 cPcQP AX1\n2 c@1cQ@1 AX1\n") == 0);
+    CHECK(verify_rc("1 c*PcQ$1 AX1\n") == 0);
+    CHECK(verify_rc("1 cPcQP AX1\n2 c@2cQ@2 AX1\n") == -202);     // itself
+    CHECK(verify_rc("1 cPcQP AX1\n2 c@3cQ@3 AX1\n3 P Premise\n") == -202);   // a later line
+    CHECK(verify_rc("1 cPcQP AX1\n2 c@0cQ@0 AX1\n") == -202);
+    CHECK(verify_rc("1 c$1cQ*P AX1\n") == -202);                   // forward $k
+    CHECK(verify_rc("1 c*PcQ$2 AX1\n") == -202);                   // no such definition
+    CHECK(verify_rc("1 *c$1P AX1\n") == -202);                     // inside its own definition
+    CHECK(verify_rc("1 cPcQ* AX1\n") == -202);                     // unterminated *
+    CHECK(verify_rc("1 c*PcQ$ AX1\n") == -202);                    // $ without a number
+}
+
+/* A binary proof checks exactly like its text. */
+static void test_binary_round_trip(void) {
+    for (size_t k = 0; k < sizeof ROUND_TRIP / sizeof *ROUND_TRIP; ++k) {
+        char *bin = NULL, *a = NULL, *b = NULL, *back = NULL;
+        size_t len = 0;
+        int rc = pc_proof_to_binary(ROUND_TRIP[k], &bin, &len);
+        if (strstr(ROUND_TRIP[k], "Bogus")) { CHECK(rc != 0); continue; }   // no such rule to encode
+        CHECK(rc == 0);
+        if (rc != 0) continue;
+        CHECK(verify_proof(ROUND_TRIP[k], &a) == verify_proof_binary(bin, len, &b));
+        CHECK(a && b && strcmp(a, b) == 0);
+        CHECK(pc_proof_from_binary(bin, len, &back) == 0);
+        CHECK(back && verify_rc(back) == verify_rc(ROUND_TRIP[k]));
+        free_output(a);
+        free_output(b);
+        free_output(back);
+        free_output(bin);
+    }
+}
+
+/* pcb_open refuses a buffer that is cut short or whose tables disagree. */
+static void test_binary_rejects(void) {
+    char *bin = NULL;
+    size_t len = 0;
+    CHECK(pc_proof_to_binary(ROUND_TRIP[1], &bin, &len) == 0);
+    if (!bin) return;
+    uint32_t *copy = malloc(len + 4);
+    PcbView v;
+    CHECK(pcb_open(bin, len, &v));
+    CHECK(!pcb_open(bin, len - 4, &v));
+    CHECK(!pcb_open(bin, sizeof(PcbHeader) - 1, &v));
+    CHECK(!pcb_open(NULL, len, &v));
+    memcpy((char*)copy + 1, bin, len);
+    CHECK(!pcb_open((char*)copy + 1, len, &v));                 // misaligned
+
+#define CORRUPT(stmt) do { \
+        memcpy(copy, bin, len); \
+        PcbHeader *h = (PcbHeader*)copy; \
+        uint32_t *off = (uint32_t*)(h + 1); \
+        PcbLine *ln = (PcbLine*)((char*)(off + h->n_formulas + 1) + PCB_ALIGN4((size_t)h->n_symbols)); \
+        (void)off; (void)ln; \
+        stmt; \
+        CHECK(!pcb_open(copy, len, &v)); \
+        char *out = NULL; \
+        CHECK(verify_proof_binary(copy, len, &out) == -210); \
+        free_output(out); \
+    } while (0)
+
+    CORRUPT(h->magic[0] = 'X');
+    CORRUPT(h->version++);
+    CORRUPT(h->n_lines++);
+    CORRUPT(h->n_formulas--);
+    CORRUPT(off[1] = off[2] + 1);                               // offsets out of order
+    CORRUPT(((char*)(off + h->n_formulas + 1))[0] = 'x');       // not a symbol
+    CORRUPT(((char*)(off + h->n_formulas + 1))[0] = 'P');       // not one formula
+    CORRUPT(ln[0].formula = h->n_formulas);
+    CORRUPT(ln[1].rule = 0xEE);
+#undef CORRUPT
+    free(copy);
+    free_output(bin);
+}
+
+/* ---------------- Snapshots ---------------- */
+
+static char *slurp(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    rewind(f);
+    char *buf = malloc(*len);
+    if (buf && fread(buf, 1, *len, f) != *len) { free(buf); buf = NULL; }
+    fclose(f);
+    return buf;
+}
+
+static void spit(const char *path, const char *buf, size_t len) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return;
+    fwrite(buf, 1, len, f);
+    fclose(f);
+}
+
+/* Restore `len` bytes of the image, with entry `id` altered by `patch`
+   when it is non-NULL; returns pc_store_restore's result and detaches. */
+static int restore_patched(const char *path, const char *img, size_t len, uint32_t id,
+                           void (*patch)(StoreEntry *e, uint32_t *slots, const StoreHeader *h)) {
+    char *copy = malloc(len);
+    memcpy(copy, img, len);
+    if (patch) {
+        StoreHeader *h = (StoreHeader*)copy;
+        StoreEntry *e = (StoreEntry*)(h + 1);
+        patch(&e[id], (uint32_t*)(e + h->capacity), h);
+    }
+    spit(path, copy, len);
+    free(copy);
+    int rc = pc_store_restore(path);
+    pc_store_detach();
+    return rc;
+}
+
+static void fwd_child(StoreEntry *e, uint32_t *slots, const StoreHeader *h) { (void)slots; e->left = atomic_load(&h->count) - 1; }
+static void bad_kind(StoreEntry *e, uint32_t *slots, const StoreHeader *h) { (void)slots; (void)h; e->kind = 'X'; }
+static void bad_atom(StoreEntry *e, uint32_t *slots, const StoreHeader *h) { (void)slots; (void)h; e->atom = 'p'; }
+static void bad_flags(StoreEntry *e, uint32_t *slots, const StoreHeader *h) { (void)slots; (void)h; atomic_store(&e->flags, 6u); }
+static void big_count(StoreEntry *e, uint32_t *slots, const StoreHeader *h) { (void)e; (void)slots; atomic_store(&((StoreHeader*)h)->count, h->capacity + 1); }
+static void bad_slot(StoreEntry *e, uint32_t *slots, const StoreHeader *h) {
+    (void)e;
+    for (uint32_t k = 0; k < h->nslots; ++k)
+        if (!slots[k]) { slots[k] = atomic_load(&h->count); break; }
+}
+
+/* A snapshot restores every formula and lemma; a truncated or damaged one
+   is refused rather than mapped. */
+static void test_snapshot_restore(void) {
+    char path[] = "/tmp/pc_snapXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    close(fd);
+    char bad[sizeof path + 8];
+    snprintf(bad, sizeof bad, "%s.bad", path);
+
+    CHECK(pc_store_create(1024) == 0);
+    CHECK(verify_rc("1 cPcQP AX1\n2 ccPcQPcRcPcQP AX1\n3 cRcPcQP MP 1 2\n") == 0);
+    CHECK(verify_rc("1 cSS Premise\n") == 0);
+    unsigned formulas = 0, lemmas = 0, f2 = 0, l2 = 0;
+    pc_store_stats(&formulas, &lemmas);
+    CHECK(pc_store_snapshot(path) == 0);
+    pc_store_detach();
+
+    CHECK(pc_store_restore(path) == 0);
+    pc_store_stats(&f2, &l2);
+    CHECK(f2 == formulas && l2 == lemmas && lemmas == 3);
+    CHECK(verify_rc("1 cRcPcQP Lemma\n") == 0);
+    CHECK(verify_rc("1 cSS Lemma\n") != 0);
+    CHECK(pc_store_intern("cRcPcQP") != 0);
+    pc_store_detach();
+
+    size_t len = 0;
+    char *img = slurp(path, &len);
+    CHECK(img != NULL);
+    if (img) {
+        CHECK(restore_patched(bad, img, len, 0, NULL) == 0);
+        CHECK(restore_patched(bad, img, len / 2, 0, NULL) < 0);
+        CHECK(restore_patched(bad, img, sizeof(StoreHeader) - 1, 0, NULL) < 0);
+        CHECK(restore_patched(bad, img, len, 4, fwd_child) == -5);
+        CHECK(restore_patched(bad, img, len, 2, bad_kind) == -5);
+        CHECK(restore_patched(bad, img, len, 1, bad_atom) == -5);
+        CHECK(restore_patched(bad, img, len, 3, bad_flags) == -5);
+        CHECK(restore_patched(bad, img, len, 0, big_count) == -5);
+        CHECK(restore_patched(bad, img, len, 0, bad_slot) == -5);
+        CHECK(g_store == NULL);
+        free(img);
+    }
+    unlink(path);
+    unlink(bad);
+}
+
+/* ---------------- Proof search ---------------- */
+
+typedef struct {
+    const char *goal;
+    const char *premises[4];
+    int n;
+} ProveCase;
+
+static const ProveCase PROVABLE[] = {
+    { "cPP", { 0 }, 0 },
+    { "Q", { "P", "cPQ" }, 2 },
+    { "cPR", { "cPQ", "cQR" }, 2 },
+    { "cPT", { "cPQ", "cQR", "cRS", "cST" }, 4 },      // a premise chain
+    { "cPcQcRcSP", { 0 }, 0 },
+};
+
+/* 0 if `proof` proves the case's goal from exactly its premises. */
+static int recheck(const ProveCase *c, const char *proof) {
+    char *out = NULL;
+    int rc = verify_proof_goal(proof, c->premises, c->n, c->goal, &out);
+    free_output(out);
+    return rc;
+}
+
+/* Every proof pc_prove emits re-checks; a budget it runs out of, or a goal
+   that does not follow, gives 1; a formula that is not a WFF gives -220. */
+static void test_prove(void) {
+    for (size_t k = 0; k < sizeof PROVABLE / sizeof *PROVABLE; ++k) {
+        const ProveCase *c = &PROVABLE[k];
+        pc_prove_options o = { 0 };
+        char *proof = NULL;
+        CHECK(pc_prove(c->premises, c->n, c->goal, &o, &proof) == 0);
+        CHECK(proof && recheck(c, proof) == 0);
+        CHECK(o.expanded > 0 && o.expanded <= 20000);
+        free_output(proof);
+    }
+    pc_prove_options o = { .max_goals = 5 };
+    char *proof = NULL;
+    CHECK(pc_prove(NULL, 0, "cPcQcRcSP", &o, &proof) == 1);
+    CHECK(proof == NULL && o.expanded <= 5);
+    CHECK(pc_prove(NULL, 0, "P", NULL, &proof) == 1);
+    const char *prem[] = { "cPQ" };
+    CHECK(pc_prove(prem, 1, "cQP", &(pc_prove_options){ .max_goals = 2000 }, &proof) == 1);
+    CHECK(pc_prove(NULL, 0, "cPx", NULL, &proof) == -220);
+    CHECK(pc_prove(prem, 1, "", NULL, &proof) == -220);
+    const char *bad[] = { "cPQQ" };
+    CHECK(pc_prove(bad, 1, "cPP", NULL, &proof) == -220);
+    CHECK(proof == NULL);
+}
+
+typedef struct {
+    ProveShared S;
+    pc_prove_options opts;
+    _Atomic int cancel;
+    int rc;
+    unsigned long expanded;
+} CancelCtx;
+
+static void *cancel_worker(void *arg) {
+    CancelCtx *c = (CancelCtx*)arg;
+    char *proof = NULL;
+    c->rc = pv_run(&c->S, &c->opts, &c->cancel, &proof, &c->expanded);
+    free(proof);
+    return NULL;
+}
+
+/* A losing strategy stops once the winner raises the cancel flag.  Strategy
+   3 on cPcQcRcSP fills its formula table (~90000 goals, most of a second)
+   when left alone. */
+static void test_prove_cancel(void) {
+    CancelCtx c;
+    memset(&c, 0, sizeof c);
+    CHECK(pv_shared_init(&c.S, NULL, 0, "cPcQcRcSP", PROVE_CAPACITY) == 0);
+    c.opts = PORTFOLIO[3];
+    c.opts.max_size = PORTFOLIO[3].max_size * (c.S.largest + 4);
+    c.opts.max_goals = 5000000;
+    atomic_store(&c.cancel, 1);
+    cancel_worker(&c);
+    CHECK(c.rc == 1 && c.expanded <= 1);
+
+    atomic_store(&c.cancel, 0);
+    pthread_t t;
+    pthread_create(&t, NULL, cancel_worker, &c);
+    usleep(20000);
+    atomic_store(&c.cancel, 1);
+    pthread_join(t, NULL);
+    CHECK(c.rc == 1 && c.expanded < 60000);
+    pv_shared_free(&c.S);
+}
+
+/* The portfolio returns a proof that re-checks and names the strategy that
+   found it; a search none of them can finish still ends in 1. */
+static void test_portfolio(void) {
+    for (size_t k = 0; k < sizeof PROVABLE / sizeof *PROVABLE; ++k) {
+        const ProveCase *c = &PROVABLE[k];
+        pc_prove_options o = { .max_goals = 5000000 };
+        char *proof = NULL;
+        CHECK(pc_prove_portfolio(c->premises, c->n, c->goal, 4, &o, &proof) == 0);
+        CHECK(proof && recheck(c, proof) == 0);
+        CHECK(o.strategy >= 0 && o.strategy < 4);
+        free_output(proof);
+    }
+    pc_prove_options o = { .max_goals = 200 };
+    char *proof = NULL;
+    CHECK(pc_prove_portfolio(NULL, 0, "P", 4, &o, &proof) == 1);
+    CHECK(proof == NULL && o.strategy == -1);
+    CHECK(pc_prove_portfolio(NULL, 0, "cPx", 4, NULL, &proof) == -220);
+}
+
+/* ---------------- Store sweeps ---------------- */
+
+enum { SWEEP_THREADS = 4, SWEEP_CALLS = 3000, SWEEP_HIGH = 1024, SWEEP_LOW = 512 };
+
+typedef struct {
+    int tid;
+    unsigned max_count;   // most formulas seen in the store
+    int lemma_lost;       // a Lemma citation of the seeded lemma failed
+} SweepCtx;
+
+/* Checks a fresh premise per call, so every call interns new formulas that
+   do not become lemmas, and cites the seeded lemma now and then. */
+static void *sweep_worker(void *arg) {
+    SweepCtx *c = (SweepCtx*)arg;
+    char f[64], proof[160];
+    for (int i = 0; i < SWEEP_CALLS; ++i) {
+        /* a right-nested implication chain spelling tid and i in base 26 */
+        unsigned v = (unsigned)c->tid * 1000000u + (unsigned)i;
+        char *p = f;
+        do {
+            *p++ = 'c';
+            *p++ = (char)('A' + v % 26);
+            v /= 26;
+        } while (v);
+        *p++ = 'Z';
+        *p = '\0';
+        snprintf(proof, sizeof proof, "1 c%scQ%s Premise\n", f, f);
+        if (verify_rc(proof) != 0) c->lemma_lost++;
+        if (i % 50 == 0 && verify_rc("1 cPcQP Lemma\n") != 0) c->lemma_lost++;
+        unsigned n = 0;
+        pc_store_stats(&n, NULL);
+        if (n > c->max_count) c->max_count = n;
+    }
+    return NULL;
+}
+
+/* Calls that keep overlapping must not hold off a sweep: the store stays
+   near its high watermark and lemmas survive every sweep. */
+static void test_sweep_under_load(void) {
+    CHECK(pc_store_create(8192) == 0);
+    CHECK(pc_store_set_watermarks(SWEEP_HIGH, SWEEP_LOW) == 0);
+    CHECK(verify_rc("1 cPcQP AX1\n") == 0);
+    pthread_t t[SWEEP_THREADS];
+    SweepCtx c[SWEEP_THREADS];
+    for (int k = 0; k < SWEEP_THREADS; ++k) {
+        c[k] = (SweepCtx){ k, 0, 0 };
+        pthread_create(&t[k], NULL, sweep_worker, &c[k]);
+    }
+    for (int k = 0; k < SWEEP_THREADS; ++k) {
+        pthread_join(t[k], NULL);
+        CHECK(c[k].lemma_lost == 0);
+        /* each call adds at most a dozen formulas past the watermark */
+        CHECK(c[k].max_count <= SWEEP_HIGH + SWEEP_THREADS * 16);
+    }
+    CHECK(verify_rc("1 cPcQP Lemma\n") == 0);
+    pc_store_detach();
+}
+
+/* ---------------- Metrics ---------------- */
+
+/* Every value lands in the bucket whose bound covers it, and bucket bounds
+   step by at most 1/16 of the value. */
+static void test_hist_buckets(void) {
+    for (int b = 0; b < PC_HIST_BUCKETS; ++b) {
+        uint64_t hi = pc_hist_bucket_max(b);
+        CHECK(hist_bucket(hi) == b);
+        if (b + 1 < PC_HIST_BUCKETS) {
+            CHECK(hist_bucket(hi + 1) == b + 1);
+            CHECK(pc_hist_bucket_max(b + 1) - hi <= (hi + 1) / 16 + 1);
+        }
+    }
+    CHECK(pc_hist_bucket_max(PC_HIST_BUCKETS - 1) == UINT64_MAX);
+    CHECK(hist_bucket(15) == 15 && hist_bucket(16) == 16 && hist_bucket(17) == 17);
+    CHECK(hist_bucket(32) == 32 && hist_bucket(33) == 32 && hist_bucket(34) == 33);
+}
+
+/* Quantiles of a known distribution come out within a bucket of the truth. */
+static void test_hist_quantiles(void) {
+    static pc_histogram h;
+    memset(&h, 0, sizeof h);
+    CHECK(pc_hist_quantile(&h, 0.5) == 0);
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        h.buckets[hist_bucket(v)]++;
+        h.count++;
+        h.sum += v;
+    }
+    h.max = 1000;
+    uint64_t p50 = pc_hist_quantile(&h, 0.5), p99 = pc_hist_quantile(&h, 0.99);
+    CHECK(p50 >= 500 && p50 <= 500 + 500 / 16);
+    CHECK(p99 >= 990 && p99 <= 1000);
+    CHECK(pc_hist_quantile(&h, 0) == 1);
+    CHECK(pc_hist_quantile(&h, 1) == 1000);
+    CHECK(pc_hist_quantile(&h, 2) == 1000);
+}
+
+/* Each call is counted once under its return code, with its size. */
+static void test_metrics_calls(void) {
+    static pc_metrics m;
+    const char *ok = "1 cPcQP AX1\n2 P Premise\n3 cQP MP 2 1\n";
+    const char *bad = "1 cPP AX1\n";
+    pc_metrics_enable(1);
+    pc_metrics_snapshot(&m, 1);
+    for (int k = 0; k < 3; ++k) CHECK(verify_rc(ok) == 0);
+    for (int k = 0; k < 2; ++k) CHECK(verify_rc(bad) == 1);
+    CHECK(verify_rc("") == -201);
+    pc_metrics_snapshot(&m, 1);
+    CHECK(m.rc[PC_RC_SLOT(0)] == 3);
+    CHECK(m.rc[PC_RC_SLOT(1)] == 2);
+    CHECK(m.rc[PC_RC_SLOT(-201)] == 1);
+    CHECK(m.hist[PC_HIST_VERIFY_NS].count == 6);
+    CHECK(m.hist[PC_HIST_PROOF_BYTES].sum == 3 * strlen(ok) + 2 * strlen(bad));
+    CHECK(m.hist[PC_HIST_PROOF_BYTES].max == strlen(ok));
+    CHECK(m.hist[PC_HIST_PROOF_LINES].sum == 3 * 3 + 2 * 1);
+    CHECK(m.hist[PC_HIST_PROOF_LINES].buckets[3] == 3);
+    /* reset drained the counters, and nothing is recorded while off */
+    pc_metrics_enable(0);
+    CHECK(verify_rc(ok) == 0);
+    pc_metrics_snapshot(&m, 0);
+    CHECK(m.rc[PC_RC_SLOT(0)] == 0 && m.hist[PC_HIST_VERIFY_NS].count == 0);
+}
+
+/* ---------------- Streaming ---------------- */
+
+typedef struct {
+    int stop_after;       // stop after this many line verdicts
+    int lines;            // line verdicts seen
+} StreamCtx;
+
+static int stop_cb(const pc_line_result *r, void *ctx) {
+    StreamCtx *c = (StreamCtx*)ctx;
+    if (r->line == 0) return 0;
+    return ++c->lines >= c->stop_after;
+}
+
+static void test_stream_stop(void) {
+    const char *proof = "1 cPcQP AX1\n2 P Premise\n3 cQP MP 2 1\n";
+    StreamCtx c = { 1, 0 };
+    CHECK(verify_proof_stream(proof, strlen(proof), stop_cb, &c) == -230);
+    CHECK(c.lines == 1);
+    c = (StreamCtx){ 100, 0 };
+    CHECK(verify_proof_stream(proof, strlen(proof), stop_cb, &c) == 0);
+    CHECK(c.lines == 3);
+}
+
+/* A stream stopped after a valid line must not turn the unchecked rest of
+   the proof into lemmas. */
+static void test_stream_stop_records_no_lemmas(void) {
+    CHECK(pc_store_create(1024) == 0);
+    const char *proof = "1 cPcQP AX1\n2 P AX1\n";
+    StreamCtx c = { 1, 0 };
+    CHECK(verify_proof_stream(proof, strlen(proof), stop_cb, &c) == -230);
+    CHECK(verify_rc("1 P Lemma\n") != 0);
+    CHECK(verify_rc("1 cPcQP Lemma\n") != 0);
+    pc_store_detach();
+}
+
+/* ---------------- Report limits ---------------- */
+
+typedef struct {
+    int truncated;        // a "[report truncated" message arrived
+} NoticeCtx;
+
+static int notice_cb(const pc_line_result *r, void *ctx) {
+    NoticeCtx *c = (NoticeCtx*)ctx;
+    if (r->line == 0 && r->message && strstr(r->message, "[report truncated")) c->truncated = 1;
+    return 0;
+}
+
+static void test_report_limits(void) {
+    /* a text the marker would lengthen is shown whole, a long one is elided */
+    pc_report_limits(10, 0);
+    CHECK(strcmp(shown("ccPQcQRcPRR", 0), "ccPQcQRcPRR") == 0);
+    const char *lng = "cccccccccccccccccccccccccccccccccccccccccPQRSTUVWXYZABCDEFGHIJKLMNOP";
+    CHECK(strlen(shown(lng, 0)) < strlen(lng));
+    for (int k = 0; k < 2; ++k) sb_free(&t_shown[k]);
+
+    /* a capped stream still says it was capped */
+    pc_report_limits(0, 16);
+    const char *proof = "1 P Bogus\n";
+    NoticeCtx c = { 0 };
+    CHECK(verify_proof_stream(proof, strlen(proof), notice_cb, &c) == 1);
+    CHECK(c.truncated);
+    pc_report_limits(0, 0);
+}
+
+int main(void) {
+    test_packed_boundary();
+    test_lemmas();
+    test_compressed_round_trip();
+    test_compressed_rejects();
+    test_binary_round_trip();
+    test_binary_rejects();
+    test_snapshot_restore();
+    test_prove();
+    test_prove_cancel();
+    test_portfolio();
+    test_sweep_under_load();
+    test_hist_buckets();
+    test_hist_quantiles();
+    test_metrics_calls();
+    test_stream_stop();
+    test_stream_stop_records_no_lemmas();
+    test_report_limits();
+    printf("%d checks, %d failed\n", g_checks, g_failed);
+    return g_failed ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+# test_standalone.py
+# Tests for the standalone checker's command line: builds it with
+# -DBUILD_STANDALONE into a temporary directory and runs its modes on small
+# inputs.
+#
+#   python3 test_standalone.py
+import json
+import os
+import subprocess
+import tempfile
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+BIN = None
+
+
+def setUpModule():
+    global BIN, _build
+    _build = tempfile.TemporaryDirectory()
+    BIN = os.path.join(_build.name, "proof_checker")
+    subprocess.run([os.environ.get("CC", "gcc"), "-std=c11", "-O2", "-pthread", "-DBUILD_STANDALONE",
+                    "-o", BIN, os.path.join(HERE, "proof_checker.c")], check=True)
+
+
+def tearDownModule():
+    _build.cleanup()
+
+
+def run(args, stdin=""):
+    return subprocess.run([BIN] + args, input=stdin, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+
+
+def records(stdout):
+    return [json.loads(line) for line in stdout.splitlines()]
+
+
+class ModeTest(unittest.TestCase):
+    def test_modes(self):
+        self.assertEqual(run([], "1 cPcQP AX1\n").returncode, 0)
+        res = run(["--stream"], "1 cPcQP AX1\n")
+        self.assertEqual(res.returncode, 0)
+        self.assertTrue(records(res.stdout)[0]["ok"])
+
+    def test_unknown_option(self):
+        for opt in ("--bogus", "--streams", "--"):
+            res = run([opt], "1 cPcQP AX1\n")
+            self.assertEqual(res.returncode, 2, opt)
+            self.assertIn("unknown option", res.stderr)
+            self.assertIn("usage:", res.stderr)
+            self.assertEqual(res.stdout, "")
+
+
+class BatchTest(unittest.TestCase):
+    def batch(self, recs, *extra):
+        text = "".join((r if isinstance(r, str) else json.dumps(r)) + "\n" for r in recs)
+        res = run(["--batch"] + list(extra), text)
+        self.assertEqual(res.returncode, 0, res.stderr)
+        return records(res.stdout)
+
+    def test_malformed_records(self):
+        out = self.batch(["not json", '{"id": 1, "proof": "1 P AX1', '{"id": 2, "proof": 5}'])
+        self.assertEqual([r["rc"] for r in out], [-300, -300, -300])
+        self.assertEqual([r["id"] for r in out], [None, 1, 2])
+
+    def test_missing_proof(self):
+        out = self.batch([{"id": "a", "goal": "P"}])
+        self.assertEqual(out[0]["rc"], -300)
+        self.assertIn("no proof", out[0]["output"])
+
+    def test_goal_and_premises(self):
+        mp = "1 P Premise\n2 cPQ Premise\n3 Q MP 1 2\n"
+        out = self.batch([
+            {"id": 1, "premises": ["P", "cPQ"], "goal": "Q", "proof": mp},
+            {"id": 2, "premises": ["P", "cPQ"], "goal": "P", "proof": mp},
+            {"id": 3, "premises": ["P"], "goal": "Q", "proof": mp},
+            {"id": 4, "goal": "P", "proof": "1 P Premise\n"},
+            {"id": 5, "proof": mp},
+            {"id": 6, "goal": "cPcQP", "proof": "1 cPcQP AX1\n"},
+        ])
+        self.assertEqual([r["valid"] for r in out], [True, False, False, False, True, True])
+        self.assertIn("Goal not reached", out[1]["output"])
+
+    def test_escapes(self):
+        out = self.batch([
+            '{"id": 1, "proof": "1 cPcQP AX1\\n"}',
+            '{"id": 2, "proof": "1 P\\u0000 AX1"}',      # would cut the proof short
+            '{"id": 3, "proof": "\\ud83d\\ude00"}',    # surrogate pair
+            '{"id": 4, "proof": "\\ud83d x"}',           # lone high surrogate
+            '{"id": 5, "proof": "\\ude00"}',             # lone low surrogate
+            '{"id": 6, "proof": "\\u12"}',
+        ])
+        self.assertEqual(out[0]["rc"], 0)
+        self.assertEqual([r["rc"] for r in out[1:]], [-300, -201, -300, -300, -300])
+        self.assertIn("\U0001F600", out[2]["output"])
+
+    def test_ordered_output(self):
+        recs = [{"id": k, "proof": "1 cPcQP AX1\n" * (1 + (k * 7) % 40)} for k in range(300)]
+        out = self.batch(recs, "--jobs", "4")
+        self.assertEqual([r["id"] for r in out], list(range(300)))
+        unordered = self.batch(recs, "--jobs", "4", "--completion-order")
+        self.assertEqual(sorted(r["id"] for r in unordered), list(range(300)))
+
+    def test_unknown_option(self):
+        res = run(["--batch", "--bogus"])
+        self.assertEqual(res.returncode, 2)
+        self.assertIn("unknown batch option", res.stderr)
+
+
+class ProveTest(unittest.TestCase):
+    def test_found(self):
+        res = run(["--prove", "cPR", "cPQ", "cQR"])
+        self.assertEqual(res.returncode, 0, res.stderr)
+        self.assertEqual(res.stdout.splitlines()[-1].split()[1], "cPR")
+        # the printed proof checks
+        check = run([], res.stdout)
+        self.assertEqual(check.returncode, 0, check.stdout)
+
+    def test_not_found(self):
+        res = run(["--prove", "--max-goals", "50", "P"])
+        self.assertEqual(res.returncode, 1)
+        self.assertIn("no proof found", res.stderr)
+
+    def test_bad_formula(self):
+        for args in (["cPx"], ["cPP", "cPQQ"]):
+            res = run(["--prove"] + args)
+            self.assertEqual(res.returncode, 2, args)
+            self.assertIn("not a well-formed formula", res.stderr)
+
+    def test_no_goal(self):
+        res = run(["--prove"])
+        self.assertEqual(res.returncode, 2)
+        self.assertIn("usage", res.stderr)
+
+
+class DirTest(unittest.TestCase):
+    PROOFS = {
+        "ok.txt": "1 cPcQP AX1\n",
+        "sub/mp.txt": "1 P Premise\n2 cPQ Premise\n3 Q MP 1 2\n",
+        "sub/deeper/bad.txt": "1 cPP AX1\n",
+        "empty.txt": "",
+    }
+
+    def setUp(self):
+        self.dir = tempfile.TemporaryDirectory()
+        for name, text in self.PROOFS.items():
+            path = os.path.join(self.dir.name, name)
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(path, "w") as f:
+                f.write(text)
+
+    def tearDown(self):
+        self.dir.cleanup()
+
+    def verdicts(self, *extra):
+        res = run(["--dir", self.dir.name] + list(extra))
+        self.assertEqual(res.returncode, 0, res.stderr)
+        return {os.path.relpath(r["id"], self.dir.name): (r["rc"], r["valid"]) for r in records(res.stdout)}
+
+    def test_every_file_checked_once(self):
+        got = self.verdicts()
+        self.assertEqual(set(got), set(self.PROOFS))
+        self.assertEqual(got["ok.txt"], (0, True))
+        self.assertEqual(got["sub/mp.txt"], (0, True))
+        self.assertEqual(got["sub/deeper/bad.txt"][1], False)
+        self.assertFalse(got["empty.txt"][1])
+
+    def test_workers_read_the_same(self):
+        self.assertEqual(self.verdicts(), self.verdicts("--no-uring", "--jobs", "3"))
+
+    def test_many_groups(self):
+        # more files than one io_uring group
+        for k in range(150):
+            with open(os.path.join(self.dir.name, "g%03d.txt" % k), "w") as f:
+                f.write("1 cPcQP AX1\n" if k % 2 else "1 cPP AX1\n")
+        got = self.verdicts("--jobs", "4")
+        self.assertEqual(len(got), len(self.PROOFS) + 150)
+        for k in range(150):
+            self.assertEqual(got["g%03d.txt" % k][1], k % 2 == 1)
+
+    def test_file_over_4gib(self):
+        # a sparse file past the 32-bit read length: its proof ends at the
+        # first NUL, so checking it is cheap unless the file is read whole
+        path = os.path.join(self.dir.name, "huge.txt")
+        with open(path, "w") as f:
+            f.write("1 cPcQP AX1\n")
+        try:
+            os.truncate(path, (1 << 32) + 12)
+        except OSError:
+            self.skipTest("no sparse files here")
+        got = self.verdicts()
+        self.assertEqual(got["huge.txt"], (0, True))
+
+    def test_missing_dir(self):
+        res = run(["--dir", os.path.join(self.dir.name, "nope")])
+        self.assertEqual(res.returncode, 2)
+
+
+if __name__ == "__main__":
+    unittest.main()